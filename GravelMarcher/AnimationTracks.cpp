@@ -0,0 +1,111 @@
+#include "AnimationTracks.h"
+
+#include <math.h>
+
+#include <exception>
+#include <algorithm>
+
+using namespace std;
+
+void KeyFrameTrackGroup::addTrack(const float * times, const int * modes, int keyFrameCount, size_t outputOffset) {
+	if (keyFrameCount == 0) throw new exception("Can't animate something with 0 keyframes!");
+
+	AnimationTrack track;
+	track.firstKeyFrame = (int)keyFrameTimes.size();
+	track.keyFrameCount = keyFrameCount;
+	track.outputOffset = outputOffset;
+	track.cursor = 0;
+	tracks.push_back(track);
+
+	keyFrameTimes.insert(keyFrameTimes.end(), times, times + keyFrameCount);
+	keyFrameModes.insert(keyFrameModes.end(), modes, modes + keyFrameCount);
+}
+
+//Before the first keyframe, a track holds the first value, and after the last, the last.
+//In between, it's the keyframe at or before t blended toward the next, by how the one before says to.
+void KeyFrameTrackGroup::findSegments(float t) {
+	int trackCount = (int)tracks.size();
+	segmentStarts.resize(trackCount);
+	segmentEnds.resize(trackCount);
+	segmentWeights.resize(trackCount);
+
+	for (int i = 0; i < trackCount; i++) {
+		AnimationTrack & track = tracks[i];
+		const float * times = &keyFrameTimes[track.firstKeyFrame];
+		int last = track.keyFrameCount - 1;
+
+		//Walks the cursor to the last keyframe at or before t, or the first if t is before them all
+		while (track.cursor < last && times[track.cursor + 1] <= t) track.cursor++;
+		while (track.cursor > 0 && times[track.cursor] > t) track.cursor--;
+
+		int start = track.firstKeyFrame + track.cursor;
+		float weight = 0;
+		bool isBetween = t > times[0] && track.cursor < last;
+		if (isBetween && keyFrameModes[start] != INTERP_MODE_JUMP) {
+			weight = (t - times[track.cursor]) / (times[track.cursor + 1] - times[track.cursor]);
+			if (keyFrameModes[start] == INTERP_MODE_COS) {
+				weight = (1.0f - cosf(3.14159265358979f * weight)) / 2.0f;
+			}
+		}
+
+		segmentStarts[i] = start;
+		segmentEnds[i] = isBetween ? start + 1 : start;
+		segmentWeights[i] = weight;
+	}
+}
+
+float KeyFrameTrackGroup::findLength() const {
+	float length = 0;
+	for (size_t i = 0; i < tracks.size(); i++) {
+		length = max(length, keyFrameTimes[tracks[i].firstKeyFrame + tracks[i].keyFrameCount - 1]);
+	}
+	return length;
+}
+
+void SampledTrackGroup::evaluate(float t, unsigned char * block) {
+	for (size_t i = 0; i < tracks.size(); i++) {
+		const SampledAnimationTrack & track = tracks[i];
+		float position = std::min(std::max(t * track.samplesPerSecond, 0.0f), (float)(track.sampleCount - 1));
+		int before = (int)position;
+		int after = std::min(before + 1, track.sampleCount - 1);
+		float weight = position - before;
+		float value = blendKeyFrames(track.samples[before * track.sampleStride], track.samples[after * track.sampleStride], weight);
+		memcpy(block + track.outputOffset, &value, sizeof(float));
+	}
+}
+
+void addSampledAnimationTrack(AnimationRegistry & registry, const float * samples, int sampleCount, int sampleStride, float samplesPerSecond,
+	size_t outputOffset) {
+	if (sampleCount == 0) throw new exception("Can't animate something with 0 samples!");
+
+	SampledTrackGroup * group = NULL;
+	for (size_t i = 0; i < registry.groups.size() && group == NULL; i++) {
+		group = dynamic_cast<SampledTrackGroup *>(registry.groups[i].get());
+	}
+	if (group == NULL) {
+		group = new SampledTrackGroup();
+		registry.groups.push_back(std::unique_ptr<AnimationTrackGroup>(group));
+	}
+
+	SampledAnimationTrack track;
+	track.samples = samples;
+	track.sampleCount = sampleCount;
+	track.sampleStride = sampleStride;
+	track.samplesPerSecond = samplesPerSecond;
+	track.outputOffset = outputOffset;
+	group->tracks.push_back(track);
+}
+
+void evaluateAnimation(AnimationRegistry & registry, float t, void * block) {
+	for (size_t i = 0; i < registry.groups.size(); i++) {
+		registry.groups[i]->evaluate(t, (unsigned char *)block);
+	}
+}
+
+float findAnimationLength(const AnimationRegistry & registry) {
+	float length = 0;
+	for (size_t i = 0; i < registry.groups.size(); i++) {
+		length = max(length, registry.groups[i]->findLength());
+	}
+	return length;
+}
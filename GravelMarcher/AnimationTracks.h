@@ -0,0 +1,178 @@
+#pragma once
+
+//The timeline. Every animated value is a track of keyframes, registered once with the block it's written into and where in it.
+//Tracks are grouped by value type, and each group keeps all its tracks' keyframes in shared arrays, so evaluating is one pass
+//over each group rather than a separate search and call per value. Each track remembers which keyframe it was at last time,
+//and time mostly moves forward a frame at a time, so finding where it is now hardly ever looks past the next keyframe.
+//Floats and vec3s are mixed, quats are slerped, and bools step, since there's nothing in between true and false.
+
+#include <stddef.h>
+#include <string.h>
+
+#include <vector>
+#include <memory>
+
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+
+#define INTERP_MODE_JUMP 0
+#define INTERP_MODE_LINEAR 1
+#define INTERP_MODE_COS 2
+
+template<typename T>
+struct AnimKeyFrame {
+	T value;
+	float frameTime;
+	int interpolationMode;
+
+	AnimKeyFrame() {
+		value, frameTime, interpolationMode = 0;
+	}
+
+	AnimKeyFrame(T value_, float time_) {
+		value = value_;
+		frameTime = time_;
+		interpolationMode = INTERP_MODE_JUMP;
+	}
+
+	AnimKeyFrame(T value_, float time_, int interpolationMode_) {
+		value = value_;
+		frameTime = time_;
+		interpolationMode = interpolationMode_;
+	}
+};
+
+//----------------------------------Blending------------------------------------------
+//How a value partway from a to b is worked out, for each type a track can hold. What these return is what gets written out,
+//so a bool track writes an int, which is how FrameParams holds them.
+
+inline float blendKeyFrames(float a, float b, float weight) { return a + (b - a) * weight; }
+inline glm::vec3 blendKeyFrames(const glm::vec3 & a, const glm::vec3 & b, float weight) { return a + (b - a) * weight; }
+inline glm::quat blendKeyFrames(const glm::quat & a, const glm::quat & b, float weight) { return glm::slerp(a, b, weight); }
+inline int blendKeyFrames(bool a, bool b, float weight) { return a ? 1 : 0; }
+
+//-----------------------------------Groups-------------------------------------------
+
+//Where one track's keyframes are in its group's arrays, and where in the block its value goes.
+struct AnimationTrack {
+	int firstKeyFrame;
+	int keyFrameCount;
+	size_t outputOffset;
+
+	//Which of its keyframes the track was last found at or after
+	int cursor;
+};
+
+//A set of tracks the registry evaluates together in one call.
+struct AnimationTrackGroup {
+	virtual ~AnimationTrackGroup() {}
+
+	//Works out every track's value at t and writes it into block.
+	virtual void evaluate(float t, unsigned char * block) = 0;
+
+	//The time of the latest keyframe of any track
+	virtual float findLength() const = 0;
+};
+
+//Every keyframed track of one value type. The part that doesn't care what the type is lives here, and the values in AnimationTrackGroupOf.
+struct KeyFrameTrackGroup : AnimationTrackGroup {
+	std::vector<AnimationTrack> tracks;
+	std::vector<float> keyFrameTimes;
+	std::vector<int> keyFrameModes;
+
+	//Filled in by findSegments: for each track, the keyframes t falls between, and how far from the first to the second.
+	std::vector<int> segmentStarts;
+	std::vector<int> segmentEnds;
+	std::vector<float> segmentWeights;
+
+	//Adds a track's timing. Its values go in separately, in the same order.
+	void addTrack(const float * times, const int * modes, int keyFrameCount, size_t outputOffset);
+
+	void findSegments(float t);
+
+	float findLength() const;
+};
+
+template<typename T>
+struct AnimationTrackGroupOf : KeyFrameTrackGroup {
+	typedef decltype(blendKeyFrames(T(), T(), 0.0f)) Output;
+
+	std::vector<T> keyFrameValues;
+	std::vector<Output> outputs;
+
+	void evaluate(float t, unsigned char * block) {
+		findSegments(t);
+
+		//Blends into one contiguous array, then scatters that into the block, so the blending loop is a straight run over the group
+		int trackCount = (int)tracks.size();
+		outputs.resize(trackCount);
+		for (int i = 0; i < trackCount; i++) {
+			outputs[i] = blendKeyFrames(keyFrameValues[segmentStarts[i]], keyFrameValues[segmentEnds[i]], segmentWeights[i]);
+		}
+		for (int i = 0; i < trackCount; i++) {
+			memcpy(block + tracks[i].outputOffset, &outputs[i], sizeof(Output));
+		}
+	}
+};
+
+//A float track that isn't keyframed, but sampled at a steady rate, like the music's spectrum. Values in between samples are mixed.
+struct SampledAnimationTrack {
+	const float * samples;
+	int sampleCount;
+
+	//How far apart, in floats, one sample is from the next, so a track can be one column of a table.
+	int sampleStride;
+
+	float samplesPerSecond;
+	size_t outputOffset;
+};
+
+//Every sampled track in a registry. The samples aren't copied, so they have to stay put for as long as the registry's used.
+struct SampledTrackGroup : AnimationTrackGroup {
+	std::vector<SampledAnimationTrack> tracks;
+
+	void evaluate(float t, unsigned char * block);
+
+	//Sampled tracks are inputs that run as long as they run, not choreography, so they don't make the timeline any longer
+	float findLength() const { return 0; }
+};
+
+//---------------------------------Registries-----------------------------------------
+
+//All the tracks that write into one kind of block, one group per value type.
+struct AnimationRegistry {
+	std::vector<std::unique_ptr<AnimationTrackGroup>> groups;
+};
+
+//Adds a track that writes its value outputOffset bytes into the block, e.g. offsetof(FrameParams, skyColor).
+//The keyframes are copied, so they needn't stick around.
+template<typename T>
+void addAnimationTrack(AnimationRegistry & registry, const AnimKeyFrame<T> keyFrames[], int keyFrameCount, size_t outputOffset) {
+	AnimationTrackGroupOf<T> * group = NULL;
+	for (size_t i = 0; i < registry.groups.size() && group == NULL; i++) {
+		group = dynamic_cast<AnimationTrackGroupOf<T> *>(registry.groups[i].get());
+	}
+	if (group == NULL) {
+		group = new AnimationTrackGroupOf<T>();
+		registry.groups.push_back(std::unique_ptr<AnimationTrackGroup>(group));
+	}
+
+	std::vector<float> times(keyFrameCount);
+	std::vector<int> modes(keyFrameCount);
+	for (int i = 0; i < keyFrameCount; i++) {
+		times[i] = keyFrames[i].frameTime;
+		modes[i] = keyFrames[i].interpolationMode;
+		group->keyFrameValues.push_back(keyFrames[i].value);
+	}
+	group->addTrack(times.data(), modes.data(), keyFrameCount, outputOffset);
+}
+
+//Adds a track that samples samples[0], samples[sampleStride], ... at samplesPerSecond, and writes a float outputOffset bytes into the block.
+void addSampledAnimationTrack(AnimationRegistry & registry, const float * samples, int sampleCount, int sampleStride, float samplesPerSecond,
+	size_t outputOffset);
+
+//Writes every track's value at t into block. Not safe to call on one registry from two threads at once, since the tracks' cursors move.
+void evaluateAnimation(AnimationRegistry & registry, float t, void * block);
+
+//The time of the latest keyframe of any track
+float findAnimationLength(const AnimationRegistry & registry);
@@ -0,0 +1,403 @@
+#include "AudioPlayer.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <mmsystem.h>
+#else
+#include <alsa/asoundlib.h>
+#endif
+
+#include <string.h>
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+//---------------------------------WAV reading-------------------------------------------
+
+bool openWavStream(const char * path, WavStream & stream) {
+	stream.file = fopen(path, "rb");
+	if (stream.file == NULL) {
+		fprintf(stderr, "Couldn't open %s\n", path);
+		return false;
+	}
+
+	char riff[12];
+	if (fread(riff, 1, 12, stream.file) != 12 || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0) {
+		fprintf(stderr, "%s isn't a WAV file\n", path);
+		closeWavStream(stream);
+		return false;
+	}
+
+	//Chunks can come in any order, and there can be others, like LIST, in between. Only fmt and data matter.
+	bool hasFormat = false;
+	int formatTag = 0;
+	while (true) {
+		char chunkID[4];
+		uint32_t chunkSize;
+		if (fread(chunkID, 1, 4, stream.file) != 4 || fread(&chunkSize, 4, 1, stream.file) != 1) {
+			fprintf(stderr, "%s has no samples\n", path);
+			closeWavStream(stream);
+			return false;
+		}
+
+		//Chunks are padded out to an even size
+		long paddedSize = (long)chunkSize + (chunkSize & 1);
+		if (memcmp(chunkID, "fmt ", 4) == 0) {
+			std::vector<uint8_t> format(paddedSize);
+			if (chunkSize < 16 || fread(format.data(), 1, paddedSize, stream.file) != (size_t)paddedSize) {
+				fprintf(stderr, "%s's format is cut short\n", path);
+				closeWavStream(stream);
+				return false;
+			}
+			formatTag = format[0] | format[1] << 8;
+			stream.channels = format[2] | format[3] << 8;
+			stream.sampleRate = format[4] | format[5] << 8 | format[6] << 16 | format[7] << 24;
+			stream.bitsPerSample = format[14] | format[15] << 8;
+
+			//WAVE_FORMAT_EXTENSIBLE keeps the real format tag at the start of its sub format GUID
+			if (formatTag == 0xFFFE && chunkSize >= 26) {
+				formatTag = format[24] | format[25] << 8;
+			}
+			stream.isFloat = formatTag == 3;
+			hasFormat = true;
+		}
+		else if (memcmp(chunkID, "data", 4) == 0) {
+			bool readable = hasFormat && stream.channels > 0 && (
+				(formatTag == 1 && stream.bitsPerSample == 16) ||
+				(formatTag == 3 && stream.bitsPerSample == 32)
+			);
+			if (!readable) {
+				fprintf(stderr, "%s isn't 16 bit PCM or 32 bit float, which are the only kinds that can be played\n", path);
+				closeWavStream(stream);
+				return false;
+			}
+			stream.frameCount = chunkSize / (stream.channels * stream.bitsPerSample / 8);
+			stream.framesRead = 0;
+			return true;
+		}
+		else {
+			fseek(stream.file, paddedSize, SEEK_CUR);
+		}
+	}
+}
+
+int readWavFrames(WavStream & stream, float * samples, int frameCapacity) {
+	int frames = (int)std::min((int64_t)frameCapacity, stream.frameCount - stream.framesRead);
+	if (frames <= 0) {
+		return 0;
+	}
+	int sampleCount = frames * stream.channels;
+	if (stream.isFloat) {
+		frames = (int)fread(samples, sizeof(float) * stream.channels, frames, stream.file);
+	}
+	else {
+		std::vector<int16_t> raw(sampleCount);
+		frames = (int)fread(raw.data(), sizeof(int16_t) * stream.channels, frames, stream.file);
+		for (int i = 0; i < frames * stream.channels; i++) {
+			samples[i] = raw[i] / 32768.0f;
+		}
+	}
+	stream.framesRead += frames;
+	return frames;
+}
+
+void closeWavStream(WavStream & stream) {
+	if (stream.file != NULL) {
+		fclose(stream.file);
+		stream.file = NULL;
+	}
+}
+
+//--------------------------------The sound device---------------------------------------
+//Both devices take 16 bit samples, the same number of channels as the file, at the file's rate.
+//writeAudioDevice blocks until the device has room, and findAudioDevicePlayedFrames is how many frames have actually come out of the speakers.
+
+//How many frames the output thread hands the device at a time
+const int audioChunkFrames = 1024;
+
+int audioChannels;
+int audioSampleRate;
+std::atomic<bool> audioQuitting(false);
+
+#ifdef _WIN32
+//waveOut plays a queue of buffers, and signals the event each time it's done with one.
+//Four of audioChunkFrames is about a tenth of a second queued at 44.1 kHz.
+const int waveOutBufferCount = 4;
+HWAVEOUT waveOut;
+HANDLE waveOutDoneEvent;
+WAVEHDR waveOutHeaders[waveOutBufferCount];
+std::vector<int16_t> waveOutBuffers[waveOutBufferCount];
+int nextWaveOutBuffer;
+
+bool openAudioDevice() {
+	WAVEFORMATEX format = {};
+	format.wFormatTag = WAVE_FORMAT_PCM;
+	format.nChannels = (WORD)audioChannels;
+	format.nSamplesPerSec = audioSampleRate;
+	format.wBitsPerSample = 16;
+	format.nBlockAlign = (WORD)(audioChannels * sizeof(int16_t));
+	format.nAvgBytesPerSec = audioSampleRate * format.nBlockAlign;
+
+	waveOutDoneEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (waveOutOpen(&waveOut, WAVE_MAPPER, &format, (DWORD_PTR)waveOutDoneEvent, 0, CALLBACK_EVENT) != MMSYSERR_NOERROR) {
+		fprintf(stderr, "Couldn't open the sound device\n");
+		CloseHandle(waveOutDoneEvent);
+		return false;
+	}
+
+	//They all start out as done, meaning free to fill
+	for (int i = 0; i < waveOutBufferCount; i++) {
+		waveOutBuffers[i].resize(audioChunkFrames * audioChannels);
+		memset(&waveOutHeaders[i], 0, sizeof(WAVEHDR));
+		waveOutHeaders[i].dwFlags = WHDR_DONE;
+	}
+	nextWaveOutBuffer = 0;
+	return true;
+}
+
+void writeAudioDevice(const int16_t * samples, int frames) {
+	WAVEHDR & header = waveOutHeaders[nextWaveOutBuffer];
+	while (!(header.dwFlags & WHDR_DONE) && !audioQuitting) {
+		WaitForSingleObject(waveOutDoneEvent, 50);
+	}
+	if (audioQuitting) {
+		return;
+	}
+	if (header.dwFlags & WHDR_PREPARED) {
+		waveOutUnprepareHeader(waveOut, &header, sizeof(WAVEHDR));
+	}
+
+	memcpy(waveOutBuffers[nextWaveOutBuffer].data(), samples, frames * audioChannels * sizeof(int16_t));
+	header.lpData = (LPSTR)waveOutBuffers[nextWaveOutBuffer].data();
+	header.dwBufferLength = frames * audioChannels * sizeof(int16_t);
+	header.dwFlags = 0;
+	waveOutPrepareHeader(waveOut, &header, sizeof(WAVEHDR));
+	waveOutWrite(waveOut, &header, sizeof(WAVEHDR));
+	nextWaveOutBuffer = (nextWaveOutBuffer + 1) % waveOutBufferCount;
+}
+
+int64_t findAudioDevicePlayedFrames() {
+	MMTIME position;
+	position.wType = TIME_SAMPLES;
+	waveOutGetPosition(waveOut, &position, sizeof(MMTIME));
+	return position.u.sample;
+}
+
+void drainAudioDevice() {
+	for (int i = 0; i < waveOutBufferCount; i++) {
+		while (!(waveOutHeaders[i].dwFlags & WHDR_DONE) && !audioQuitting) {
+			WaitForSingleObject(waveOutDoneEvent, 50);
+		}
+	}
+}
+
+void closeAudioDevice() {
+	//Resetting hands every buffer back, so they can all be unprepared
+	waveOutReset(waveOut);
+	for (int i = 0; i < waveOutBufferCount; i++) {
+		if (waveOutHeaders[i].dwFlags & WHDR_PREPARED) {
+			waveOutUnprepareHeader(waveOut, &waveOutHeaders[i], sizeof(WAVEHDR));
+		}
+	}
+	waveOutClose(waveOut);
+	CloseHandle(waveOutDoneEvent);
+}
+#else
+//ALSA keeps its own buffer, asked for as a tenth of a second, and counts how much is still waiting to be played in it
+snd_pcm_t * alsaDevice;
+int64_t alsaFramesWritten;
+
+bool openAudioDevice() {
+	if (snd_pcm_open(&alsaDevice, "default", SND_PCM_STREAM_PLAYBACK, 0) < 0) {
+		fprintf(stderr, "Couldn't open the sound device\n");
+		return false;
+	}
+	int result = snd_pcm_set_params(alsaDevice, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED, audioChannels, audioSampleRate, 1, 100000);
+	if (result < 0) {
+		fprintf(stderr, "The sound device can't play the music: %s\n", snd_strerror(result));
+		snd_pcm_close(alsaDevice);
+		return false;
+	}
+	alsaFramesWritten = 0;
+	return true;
+}
+
+void writeAudioDevice(const int16_t * samples, int frames) {
+	while (frames > 0 && !audioQuitting) {
+		snd_pcm_sframes_t written = snd_pcm_writei(alsaDevice, samples, frames);
+		if (written < 0) {
+			//Underruns and being suspended can be picked back up from. Anything else, this stops the music by giving up.
+			if (snd_pcm_recover(alsaDevice, (int)written, 1) < 0) {
+				audioQuitting = true;
+			}
+			continue;
+		}
+		samples += written * audioChannels;
+		frames -= (int)written;
+		alsaFramesWritten += written;
+	}
+}
+
+int64_t findAudioDevicePlayedFrames() {
+	snd_pcm_sframes_t delay = 0;
+	if (snd_pcm_delay(alsaDevice, &delay) < 0) {
+		delay = 0;
+	}
+	return alsaFramesWritten - delay;
+}
+
+void drainAudioDevice() {
+	snd_pcm_drain(alsaDevice);
+}
+
+void closeAudioDevice() {
+	snd_pcm_close(alsaDevice);
+}
+#endif
+
+//-----------------------------------Playback--------------------------------------------
+
+//Between the decoder and the output thread. About a third of a second at 44.1 kHz, so the disk only has to keep up on average.
+//Only the decoder moves ringWritten, and only the output thread moves ringRead, so neither needs a lock.
+const int audioRingFrames = 16384;
+std::vector<int16_t> audioRing;
+std::atomic<int64_t> ringWritten(0);
+std::atomic<int64_t> ringRead(0);
+std::atomic<bool> decoderFinished(false);
+
+WavStream audioStream;
+bool audioPlaying = false;
+std::thread audioDecoderThread;
+std::thread audioOutputThread;
+
+//The clock. How many frames the device had played at clockStamp, and whether that's all of them.
+std::mutex audioClockMutex;
+int64_t clockFrames;
+std::chrono::steady_clock::time_point clockStamp;
+bool clockFinished;
+double lastPlaybackTime;
+
+//The device's position only moves along a buffer at a time, so in between, the clock runs on from the last one with the wall clock.
+//It never runs more than this far ahead of the device though, so if the device starves, the show waits for the music to catch up.
+const double audioClockMaxLead = 0.1;
+
+void publishAudioClock(bool finished) {
+	int64_t playedFrames = findAudioDevicePlayedFrames();
+	std::lock_guard<std::mutex> lock(audioClockMutex);
+	clockFrames = playedFrames;
+	clockStamp = std::chrono::steady_clock::now();
+	clockFinished = finished;
+}
+
+void decodeAudio() {
+	const int framesPerRead = 1024;
+	std::vector<float> samples(framesPerRead * audioChannels);
+	while (!audioQuitting) {
+		int64_t written = ringWritten.load(std::memory_order_relaxed);
+		if (written - ringRead.load(std::memory_order_acquire) > audioRingFrames - framesPerRead) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			continue;
+		}
+
+		int frames = readWavFrames(audioStream, samples.data(), framesPerRead);
+		if (frames == 0) {
+			break;
+		}
+		for (int frame = 0; frame < frames; frame++) {
+			int16_t * slot = &audioRing[((written + frame) % audioRingFrames) * audioChannels];
+			for (int channel = 0; channel < audioChannels; channel++) {
+				float sample = std::min(std::max(samples[frame * audioChannels + channel], -1.0f), 1.0f);
+				slot[channel] = (int16_t)(sample * 32767.0f);
+			}
+		}
+		ringWritten.store(written + frames, std::memory_order_release);
+	}
+	decoderFinished = true;
+}
+
+void outputAudio() {
+	std::vector<int16_t> chunk(audioChunkFrames * audioChannels);
+	while (!audioQuitting) {
+		int64_t read = ringRead.load(std::memory_order_relaxed);
+		int64_t available = ringWritten.load(std::memory_order_acquire) - read;
+		if (available == 0) {
+			//The decoder sets decoderFinished after its last write, so if it's set, a second look at ringWritten is the final one
+			if (decoderFinished && ringWritten.load(std::memory_order_acquire) == read) {
+				break;
+			}
+
+			//Starved. Nothing's written to fill the gap, so the device stops, and so does the clock, rather than the music falling behind it.
+			publishAudioClock(false);
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			continue;
+		}
+
+		int frames = (int)std::min(available, (int64_t)audioChunkFrames);
+		for (int frame = 0; frame < frames; frame++) {
+			memcpy(&chunk[frame * audioChannels], &audioRing[((read + frame) % audioRingFrames) * audioChannels], audioChannels * sizeof(int16_t));
+		}
+		ringRead.store(read + frames, std::memory_order_release);
+		writeAudioDevice(chunk.data(), frames);
+		publishAudioClock(false);
+	}
+	if (!audioQuitting) {
+		drainAudioDevice();
+	}
+	publishAudioClock(true);
+}
+
+bool startAudioPlayback(const char * path) {
+	if (!openWavStream(path, audioStream)) {
+		return false;
+	}
+	audioChannels = audioStream.channels;
+	audioSampleRate = audioStream.sampleRate;
+	if (!openAudioDevice()) {
+		closeWavStream(audioStream);
+		return false;
+	}
+
+	audioRing.assign(audioRingFrames * audioChannels, 0);
+	ringWritten = 0;
+	ringRead = 0;
+	decoderFinished = false;
+	audioQuitting = false;
+	clockFrames = 0;
+	clockStamp = std::chrono::steady_clock::now();
+	clockFinished = false;
+	lastPlaybackTime = 0;
+
+	audioDecoderThread = std::thread(decodeAudio);
+	audioOutputThread = std::thread(outputAudio);
+	audioPlaying = true;
+	return true;
+}
+
+double findAudioPlaybackTime() {
+	std::lock_guard<std::mutex> lock(audioClockMutex);
+	double sinceStamp = std::chrono::duration<double>(std::chrono::steady_clock::now() - clockStamp).count();
+	if (!clockFinished) {
+		sinceStamp = std::min(sinceStamp, audioClockMaxLead);
+	}
+
+	//Capping the lead can pull the clock back behind what it said before, so it holds still instead until the device catches up
+	double playbackTime = (double)clockFrames / audioSampleRate + sinceStamp;
+	lastPlaybackTime = std::max(lastPlaybackTime, playbackTime);
+	return lastPlaybackTime;
+}
+
+void stopAudioPlayback() {
+	if (!audioPlaying) {
+		return;
+	}
+	audioQuitting = true;
+	audioDecoderThread.join();
+	audioOutputThread.join();
+	closeAudioDevice();
+	closeWavStream(audioStream);
+	audioPlaying = false;
+}
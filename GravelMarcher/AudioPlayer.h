@@ -0,0 +1,39 @@
+#pragma once
+
+//Plays the music, and keeps the clock the show runs on.
+//A decoder thread streams the WAV off disk into a small ring buffer, and an output thread feeds the sound device from that,
+//so the file is never loaded all at once. The clock is how much of the music the device has actually played, so the picture
+//follows the music rather than drifting away from it. On Windows it plays through waveOut, and on Linux through ALSA (link with -lasound).
+
+#include <stdio.h>
+#include <stdint.h>
+
+//A WAV file being read a piece at a time. Only 16 bit PCM and 32 bit float can be read.
+struct WavStream {
+	FILE * file;
+	int channels;
+	int sampleRate;
+	int bitsPerSample;
+	bool isFloat;
+
+	//How many frames (one sample for each channel) the file holds, and how many have been read so far
+	int64_t frameCount;
+	int64_t framesRead;
+};
+
+//Opens path and reads up to where its samples start. Returns false, having said why on stderr, if it isn't a WAV that can be read.
+bool openWavStream(const char * path, WavStream & stream);
+
+//Reads up to frameCapacity frames into samples, interleaved and from -1 to 1. Returns how many it read, which is 0 at the end.
+int readWavFrames(WavStream & stream, float * samples, int frameCapacity);
+
+void closeWavStream(WavStream & stream);
+
+//Starts playing path. Returns false if it couldn't be opened or there's no sound device, in which case there's no clock either.
+bool startAudioPlayback(const char * path);
+
+//How far into the music the listener is, in seconds. Never goes backwards, and once the music's over, it carries on with the wall clock.
+//Only means anything if startAudioPlayback returned true.
+double findAudioPlaybackTime();
+
+void stopAudioPlayback();
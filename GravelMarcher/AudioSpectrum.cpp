@@ -0,0 +1,242 @@
+#include "AudioSpectrum.h"
+#include "AudioPlayer.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <vector>
+#include <string>
+#include <complex>
+#include <chrono>
+#include <algorithm>
+
+const char audioSpectrumMagic[4] = { 'G', 'M', 'S', 'P' };
+const uint32_t audioSpectrumVersion = 1;
+
+//-----------------------------------Baking----------------------------------------------
+
+//How many samples each FFT looks at. About 46 ms at 44.1 kHz, enough to tell apart the lowest band's bins.
+const int spectrumWindowSize = 2048;
+
+//The bands go from here to here, each the same multiple higher than the last
+const float spectrumLowestFrequency = 40.0f;
+const float spectrumHighestFrequency = 16000.0f;
+
+//How far below a band's loudest a band counts as silent
+const float spectrumRangeDecibels = 60.0f;
+
+//An in place radix 2 FFT. values.size() has to be a power of 2.
+void fft(std::vector<std::complex<float>> & values) {
+	int size = (int)values.size();
+	for (int i = 1, j = 0; i < size; i++) {
+		int bit = size >> 1;
+		for (; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j ^= bit;
+		if (i < j) {
+			std::swap(values[i], values[j]);
+		}
+	}
+	for (int length = 2; length <= size; length <<= 1) {
+		float angle = -2.0f * 3.14159265f / length;
+		std::complex<float> step(cosf(angle), sinf(angle));
+		for (int start = 0; start < size; start += length) {
+			std::complex<float> twiddle(1.0f, 0.0f);
+			for (int k = 0; k < length / 2; k++) {
+				std::complex<float> even = values[start + k];
+				std::complex<float> odd = values[start + k + length / 2] * twiddle;
+				values[start + k] = even + odd;
+				values[start + k + length / 2] = even - odd;
+				twiddle *= step;
+			}
+		}
+	}
+}
+
+int runSpectrumBake(int argc, char* argv[]) {
+	std::string wavPath = argc >= 3 ? argv[2] : "music.wav";
+	std::string outputPath = argc >= 4 ? argv[3] : "music.bands";
+
+	WavStream stream;
+	if (!openWavStream(wavPath.c_str(), stream)) {
+		fprintf(stderr, "Usage: GravelMarcher --bake-spectrum [wavPath] [outputPath]\n");
+		return -1;
+	}
+
+	auto bakeStart = std::chrono::high_resolution_clock::now();
+
+	//Which FFT bins go in which band. Every band gets at least one, even the low ones narrower than a bin.
+	float binFrequency = (float)stream.sampleRate / spectrumWindowSize;
+	float highestFrequency = std::min(spectrumHighestFrequency, stream.sampleRate * 0.5f);
+	int bandFirstBin[AUDIO_SPECTRUM_BANDS];
+	int bandEndBin[AUDIO_SPECTRUM_BANDS];
+	for (int band = 0; band < AUDIO_SPECTRUM_BANDS; band++) {
+		float low = spectrumLowestFrequency * powf(highestFrequency / spectrumLowestFrequency, (float)band / AUDIO_SPECTRUM_BANDS);
+		float high = spectrumLowestFrequency * powf(highestFrequency / spectrumLowestFrequency, (float)(band + 1) / AUDIO_SPECTRUM_BANDS);
+		bandFirstBin[band] = std::min((int)roundf(low / binFrequency), spectrumWindowSize / 2 - 1);
+		bandEndBin[band] = std::max((int)roundf(high / binFrequency), bandFirstBin[band] + 1);
+	}
+
+	std::vector<float> hann(spectrumWindowSize);
+	for (int i = 0; i < spectrumWindowSize; i++) {
+		hann[i] = 0.5f - 0.5f * cosf(2.0f * 3.14159265f * i / (spectrumWindowSize - 1));
+	}
+
+	//The last spectrumWindowSize samples, mixed down to mono. Frame i's window is centered on sample i * hop, so it starts half full of silence.
+	int hop = std::max(stream.sampleRate / AUDIO_SPECTRUM_RATE, 1);
+	int64_t frameCount = (stream.frameCount + hop - 1) / hop;
+	std::vector<float> window(spectrumWindowSize, 0.0f);
+	std::vector<float> samples(hop * stream.channels);
+	auto pushSamples = [&](int count) {
+		while (count > 0) {
+			int frames = readWavFrames(stream, samples.data(), std::min(count, hop));
+			int pushed = std::max(frames, std::min(count, hop));
+			std::copy(window.begin() + pushed, window.end(), window.begin());
+			for (int i = 0; i < pushed; i++) {
+				float mono = 0;
+				for (int channel = 0; channel < stream.channels && i < frames; channel++) {
+					mono += samples[i * stream.channels + channel];
+				}
+				window[spectrumWindowSize - pushed + i] = mono / stream.channels;
+			}
+			count -= pushed;
+		}
+	};
+	pushSamples(spectrumWindowSize / 2);
+
+	std::vector<float> decibels((size_t)frameCount * AUDIO_SPECTRUM_BANDS);
+	std::vector<std::complex<float>> values(spectrumWindowSize);
+	for (int64_t frame = 0; frame < frameCount; frame++) {
+		for (int i = 0; i < spectrumWindowSize; i++) {
+			values[i] = std::complex<float>(window[i] * hann[i], 0.0f);
+		}
+		fft(values);
+		for (int band = 0; band < AUDIO_SPECTRUM_BANDS; band++) {
+			float power = 0;
+			for (int bin = bandFirstBin[band]; bin < bandEndBin[band]; bin++) {
+				power += std::norm(values[bin]);
+			}
+			power /= bandEndBin[band] - bandFirstBin[band];
+			decibels[frame * AUDIO_SPECTRUM_BANDS + band] = 10.0f * log10f(power + 1e-12f);
+		}
+		pushSamples(hop);
+	}
+	closeWavStream(stream);
+
+	//Each band's put on its own scale, so the highs, which are always much quieter than the bass, move just as much
+	float bandLoudest[AUDIO_SPECTRUM_BANDS];
+	std::fill(bandLoudest, bandLoudest + AUDIO_SPECTRUM_BANDS, -1e30f);
+	for (size_t i = 0; i < decibels.size(); i++) {
+		bandLoudest[i % AUDIO_SPECTRUM_BANDS] = std::max(bandLoudest[i % AUDIO_SPECTRUM_BANDS], decibels[i]);
+	}
+	for (size_t i = 0; i < decibels.size(); i++) {
+		float quietest = bandLoudest[i % AUDIO_SPECTRUM_BANDS] - spectrumRangeDecibels;
+		decibels[i] = std::min(std::max((decibels[i] - quietest) / spectrumRangeDecibels, 0.0f), 1.0f);
+	}
+
+	double bakeSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - bakeStart).count();
+
+	AudioSpectrumHeader header = {};
+	memcpy(header.magic, audioSpectrumMagic, 4);
+	header.version = audioSpectrumVersion;
+	header.bandCount = AUDIO_SPECTRUM_BANDS;
+	header.frameCount = (uint32_t)frameCount;
+	header.framesPerSecond = (float)stream.sampleRate / hop;
+
+	FILE * output = fopen(outputPath.c_str(), "wb");
+	if (output == NULL || fwrite(&header, sizeof(header), 1, output) != 1 ||
+		fwrite(decibels.data(), sizeof(float), decibels.size(), output) != decibels.size()) {
+		fprintf(stderr, "Couldn't write %s\n", outputPath.c_str());
+		if (output != NULL) fclose(output);
+		return -1;
+	}
+	fclose(output);
+
+	printf("Baked %lld frames of %d bands (%.1f s of music) in %.1f ms\n",
+		(long long)frameCount, AUDIO_SPECTRUM_BANDS, (double)stream.frameCount / stream.sampleRate, bakeSeconds * 1000.0);
+	return 0;
+}
+
+//-----------------------------------Mapping---------------------------------------------
+
+bool openAudioSpectrum(const char * path, AudioSpectrum & spectrum) {
+	spectrum.mapping = NULL;
+	spectrum.mappingSize = 0;
+
+	//Once the view's mapped, the file and mapping handles can go, since the view keeps the file open by itself
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		fprintf(stderr, "Couldn't open %s\n", path);
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	HANDLE fileMapping = fileSize.QuadPart > 0 ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	if (fileMapping != NULL) {
+		spectrum.mapping = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(fileMapping);
+	}
+	CloseHandle(file);
+	spectrum.mappingSize = (size_t)fileSize.QuadPart;
+#else
+	int file = open(path, O_RDONLY);
+	if (file < 0) {
+		fprintf(stderr, "Couldn't open %s\n", path);
+		return false;
+	}
+	struct stat fileStat;
+	if (fstat(file, &fileStat) == 0 && fileStat.st_size > 0) {
+		spectrum.mapping = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (spectrum.mapping == MAP_FAILED) {
+			spectrum.mapping = NULL;
+		}
+		spectrum.mappingSize = fileStat.st_size;
+	}
+	close(file);
+#endif
+	if (spectrum.mapping == NULL) {
+		fprintf(stderr, "Couldn't map %s\n", path);
+		return false;
+	}
+
+	spectrum.header = (const AudioSpectrumHeader *)spectrum.mapping;
+	spectrum.bands = (const float *)(spectrum.header + 1);
+	bool valid = spectrum.mappingSize >= sizeof(AudioSpectrumHeader) &&
+		memcmp(spectrum.header->magic, audioSpectrumMagic, 4) == 0 &&
+		spectrum.header->version == audioSpectrumVersion &&
+		spectrum.header->bandCount == AUDIO_SPECTRUM_BANDS &&
+		spectrum.header->frameCount > 0 &&
+		spectrum.mappingSize >= sizeof(AudioSpectrumHeader) + (size_t)spectrum.header->frameCount * spectrum.header->bandCount * sizeof(float);
+	if (!valid) {
+		fprintf(stderr, "%s isn't a spectrum this can read. Bake it again with --bake-spectrum\n", path);
+		closeAudioSpectrum(spectrum);
+		return false;
+	}
+	return true;
+}
+
+void closeAudioSpectrum(AudioSpectrum & spectrum) {
+	if (spectrum.mapping == NULL) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(spectrum.mapping);
+#else
+	munmap(spectrum.mapping, spectrum.mappingSize);
+#endif
+	spectrum.mapping = NULL;
+	spectrum.header = NULL;
+	spectrum.bands = NULL;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+//The music's spectrum, worked out ahead of time so nothing takes an FFT while the show runs.
+//Usage: GravelMarcher --bake-spectrum [wavPath] [outputPath], which default to music.wav and music.bands.
+//The bake streams the WAV through an FFT, and writes how loud each of AUDIO_SPECTRUM_BANDS log spaced bands is, AUDIO_SPECTRUM_RATE times a second.
+//At startup the file is memory mapped rather than read, and each band goes into the timeline as a sampled animation track.
+
+#include <stddef.h>
+#include <stdint.h>
+
+//FrameParams.glsl's AUDIO_BAND_COUNT has to match
+#define AUDIO_SPECTRUM_BANDS 16
+#define AUDIO_SPECTRUM_RATE 100
+
+//The file starts with this, then frameCount rows of bandCount floats, each from 0 (silent) to 1 (as loud as that band ever gets).
+struct AudioSpectrumHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t bandCount;
+	uint32_t frameCount;
+	float framesPerSecond;
+	uint32_t padding;
+};
+
+//A baked spectrum, mapped into memory. bands points straight into the mapping, so it's only good until closeAudioSpectrum.
+struct AudioSpectrum {
+	const AudioSpectrumHeader * header;
+	const float * bands;
+	void * mapping;
+	size_t mappingSize;
+};
+
+//Returns false, having said why on stderr, if path can't be mapped or isn't a spectrum this version can read.
+bool openAudioSpectrum(const char * path, AudioSpectrum & spectrum);
+void closeAudioSpectrum(AudioSpectrum & spectrum);
+
+int runSpectrumBake(int argc, char* argv[]);
@@ -0,0 +1,15 @@
+//-----------------------------Checkerboard marching--------------------------------------
+//In checkerboard mode, only the pixels where (x + y + checkerboardPhase) is even are marched. Rather than drawing every pixel and
+//throwing half of them away, the marcher draws a quad over the left half of the render targets, and each of its fragments marches
+//one of those pixels. So the left half of every target holds this frame's pixels packed side by side, and CheckerboardResolve.glsl
+//interleaves them back with the reprojected half. Has to come after FrameParams.glsl.
+
+//The pixel whose march is packed into this texel of the render targets.
+ivec2 checkerboardPixel(ivec2 texel) {
+	return ivec2(texel.x * 2 + ((texel.y + checkerboardPhase) & 1), texel.y);
+}
+
+//Where a marched pixel's march is packed. Only means anything for pixels that were marched this frame.
+ivec2 checkerboardTexel(ivec2 pixel) {
+	return ivec2(pixel.x / 2, pixel.y);
+}
@@ -0,0 +1,64 @@
+#version 460 core
+
+//Fills in the pixels the marcher skipped this frame in checkerboard mode.
+//Marched pixels are unpacked from the left half of the targets, where the marcher left them. See Checkerboard.glsl.
+//Skipped ones are reprojected into last frame's resolved image, then clamped to the colors of their marched neighbors
+//so anything that moved or appeared doesn't smear.
+
+in vec3 rayView;
+
+#include "FrameParams.glsl"
+#include "Checkerboard.glsl"
+
+//What the marcher drew this frame, packed. Only the left half of each is meaningful.
+layout(binding = 0) uniform sampler2D colorTarget;
+layout(binding = 1) uniform sampler2D depthTarget;
+
+//What this pass output last frame.
+layout(binding = 2) uniform sampler2D previousResolved;
+
+out vec3 color;
+
+void main() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	if(((pixel.x + pixel.y + checkerboardPhase) & 1) == 0) {
+		color = texelFetch(colorTarget, checkerboardTexel(pixel), 0).rgb;
+		return;
+	}
+
+	//All four direct neighbors of a skipped pixel were marched.
+	//At the edge of the screen, the missing neighbor is swapped for the one on the other side.
+	ivec2 imageDimensions = textureSize(colorTarget, 0);
+	ivec2 neighborOffsets[4] = ivec2[](ivec2(1, 0), ivec2(-1, 0), ivec2(0, 1), ivec2(0, -1));
+	vec3 neighborMin = vec3(1e10);
+	vec3 neighborMax = vec3(-1e10);
+	vec3 neighborSum = vec3(0);
+	float neighborDepthSum = 0;
+	for(int i = 0; i < 4; i++) {
+		ivec2 neighbor = pixel + neighborOffsets[i];
+		if(any(lessThan(neighbor, ivec2(0))) || any(greaterThanEqual(neighbor, imageDimensions))) {
+			neighbor = pixel - neighborOffsets[i];
+		}
+		vec3 neighborColor = texelFetch(colorTarget, checkerboardTexel(neighbor), 0).rgb;
+		neighborMin = min(neighborMin, neighborColor);
+		neighborMax = max(neighborMax, neighborColor);
+		neighborSum += neighborColor;
+		neighborDepthSum += texelFetch(depthTarget, checkerboardTexel(neighbor), 0).r;
+	}
+	vec3 spatialColor = neighborSum / 4;
+
+	//Guesses where this pixel's ray hit from how far its neighbors' went, then finds where last frame's camera saw that point.
+	vec3 rayWorld = normalize((matCameraToWorld * vec4(rayView, 0)).xyz);
+	vec3 cameraPosition = (matCameraToWorld * vec4(0, 0, 0, 1)).xyz;
+	vec3 hitPointGuess = cameraPosition + rayWorld * (neighborDepthSum / 4);
+	vec4 previousView = matWorldToPreviousCamera * vec4(hitPointGuess, 1);
+	vec2 previousUV = (previousView.xy / -previousView.z) / vec2(screenRight, screenTop) * 0.5 + 0.5;
+
+	//If last frame's camera couldn't see it, the neighbors are all there is to go on
+	if(previousView.z >= 0 || any(lessThan(previousUV, vec2(0))) || any(greaterThan(previousUV, vec2(1)))) {
+		color = spatialColor;
+		return;
+	}
+
+	color = clamp(texture(previousResolved, previousUV).rgb, neighborMin, neighborMax);
+}
@@ -0,0 +1,290 @@
+#include "Denoiser.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+//How many rows each thread grabs at a time.
+const int denoiserBandRows = 16;
+
+//The B3 spline, the 1D kernel each pass's 5x5 kernel is made from.
+const float denoiserKernel[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+DenoiserSettings defaultDenoiserSettings() {
+	DenoiserSettings settings;
+	settings.iterations = 5;
+	settings.colorSigma = 0.6f;
+	settings.depthSigma = 0.02f;
+	settings.normalSquarings = 7;
+	settings.threadCount = 0;
+	return settings;
+}
+
+//Everything one pass needs. The source planes are read and the destination ones written, so passes ping-pong between two sets.
+struct DenoiserPass {
+	int width;
+	int height;
+	int step;
+	const float * sourceRed;
+	const float * sourceGreen;
+	const float * sourceBlue;
+	float * destinationRed;
+	float * destinationGreen;
+	float * destinationBlue;
+	const float * depth;
+	const float * normalX;
+	const float * normalY;
+	const float * normalZ;
+
+	//These are folded into constants once per pass, so the inner loop only multiplies.
+	float inverseColorSigmaSquared;
+	float inverseDepthSigmaStep;
+	int normalSquarings;
+};
+
+//e^x for x <= 0. Below about -87 it just gives 0. Both paths use the same formula, so SIMD and scalar pixels match.
+//Splits x into 2^i * 2^f, and approximates 2^f on [0, 1) with a polynomial.
+static inline float fastExp(float x) {
+	x = std::max(x * 1.44269504f, -126.0f);
+	float whole = floorf(x);
+	float f = x - whole;
+	float p = 1.0f + f * (0.69583354f + f * (0.22606716f + f * 0.07944023f));
+	int bits = (int(whole) + 127) << 23;
+	float scale;
+	memcpy(&scale, &bits, sizeof(scale));
+	return p * scale;
+}
+
+static inline float luminance(float r, float g, float b) {
+	return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+//Filters one pixel the straightforward way. Used near the edges, where taps get clamped, and for whatever's left over after the SIMD loop.
+static void filterPixelScalar(const DenoiserPass & pass, int x, int y) {
+	int center = y * pass.width + x;
+	float centerLuma = luminance(pass.sourceRed[center], pass.sourceGreen[center], pass.sourceBlue[center]);
+	float centerDepth = pass.depth[center];
+	float depthScale = pass.inverseDepthSigmaStep / std::max(centerDepth, 1e-4f);
+
+	float sumRed = 0, sumGreen = 0, sumBlue = 0, sumWeight = 0;
+	for (int ky = 0; ky < 5; ky++) {
+		int tapY = std::min(std::max(y + (ky - 2) * pass.step, 0), pass.height - 1);
+		for (int kx = 0; kx < 5; kx++) {
+			int tapX = std::min(std::max(x + (kx - 2) * pass.step, 0), pass.width - 1);
+			int tap = tapY * pass.width + tapX;
+
+			float lumaDifference = luminance(pass.sourceRed[tap], pass.sourceGreen[tap], pass.sourceBlue[tap]) - centerLuma;
+			float depthDifference = fabsf(pass.depth[tap] - centerDepth);
+			float normalWeight = std::max(pass.normalX[tap] * pass.normalX[center] + pass.normalY[tap] * pass.normalY[center] + pass.normalZ[tap] * pass.normalZ[center], 0.0f);
+			for (int i = 0; i < pass.normalSquarings; i++) normalWeight *= normalWeight;
+
+			float weight = denoiserKernel[kx] * denoiserKernel[ky] * normalWeight *
+				fastExp(-lumaDifference * lumaDifference * pass.inverseColorSigmaSquared - depthDifference * depthScale);
+			//The center tap always counts fully, so a pixel with no similar neighbors keeps its own color
+			if (tap == center) weight = denoiserKernel[kx] * denoiserKernel[ky];
+
+			sumRed += pass.sourceRed[tap] * weight;
+			sumGreen += pass.sourceGreen[tap] * weight;
+			sumBlue += pass.sourceBlue[tap] * weight;
+			sumWeight += weight;
+		}
+	}
+
+	pass.destinationRed[center] = sumRed / sumWeight;
+	pass.destinationGreen[center] = sumGreen / sumWeight;
+	pass.destinationBlue[center] = sumBlue / sumWeight;
+}
+
+#ifdef __AVX2__
+static inline __m256 fastExp8(__m256 x) {
+	x = _mm256_max_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504f)), _mm256_set1_ps(-126.0f));
+	__m256 whole = _mm256_floor_ps(x);
+	__m256 f = _mm256_sub_ps(x, whole);
+	__m256 p = _mm256_add_ps(_mm256_set1_ps(0.22606716f), _mm256_mul_ps(f, _mm256_set1_ps(0.07944023f)));
+	p = _mm256_add_ps(_mm256_set1_ps(0.69583354f), _mm256_mul_ps(f, p));
+	p = _mm256_add_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(f, p));
+	__m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(whole), _mm256_set1_epi32(127)), 23);
+	return _mm256_mul_ps(p, _mm256_castsi256_ps(bits));
+}
+
+static inline __m256 luminance8(__m256 r, __m256 g, __m256 b) {
+	return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, _mm256_set1_ps(0.2126f)), _mm256_mul_ps(g, _mm256_set1_ps(0.7152f))), _mm256_mul_ps(b, _mm256_set1_ps(0.0722f)));
+}
+
+//Filters 8 pixels in a row starting at x. Every tap has to be inside the image, so the caller keeps this away from the edges.
+static void filterPixels8(const DenoiserPass & pass, int x, int y) {
+	int center = y * pass.width + x;
+	__m256 centerRed = _mm256_loadu_ps(pass.sourceRed + center);
+	__m256 centerGreen = _mm256_loadu_ps(pass.sourceGreen + center);
+	__m256 centerBlue = _mm256_loadu_ps(pass.sourceBlue + center);
+	__m256 centerLuma = luminance8(centerRed, centerGreen, centerBlue);
+	__m256 centerDepth = _mm256_loadu_ps(pass.depth + center);
+	__m256 centerNormalX = _mm256_loadu_ps(pass.normalX + center);
+	__m256 centerNormalY = _mm256_loadu_ps(pass.normalY + center);
+	__m256 centerNormalZ = _mm256_loadu_ps(pass.normalZ + center);
+	__m256 depthScale = _mm256_div_ps(_mm256_set1_ps(pass.inverseDepthSigmaStep), _mm256_max_ps(centerDepth, _mm256_set1_ps(1e-4f)));
+	__m256 negativeInverseColorSigmaSquared = _mm256_set1_ps(-pass.inverseColorSigmaSquared);
+	__m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+	__m256 sumRed = _mm256_setzero_ps();
+	__m256 sumGreen = _mm256_setzero_ps();
+	__m256 sumBlue = _mm256_setzero_ps();
+	__m256 sumWeight = _mm256_setzero_ps();
+	for (int ky = 0; ky < 5; ky++) {
+		for (int kx = 0; kx < 5; kx++) {
+			__m256 kernelWeight = _mm256_set1_ps(denoiserKernel[kx] * denoiserKernel[ky]);
+			__m256 tapRed, tapGreen, tapBlue, weight;
+
+			//The center tap always counts fully, so a pixel with no similar neighbors keeps its own color
+			if (kx == 2 && ky == 2) {
+				tapRed = centerRed;
+				tapGreen = centerGreen;
+				tapBlue = centerBlue;
+				weight = kernelWeight;
+			}
+			else {
+				int tap = center + (ky - 2) * pass.step * pass.width + (kx - 2) * pass.step;
+				tapRed = _mm256_loadu_ps(pass.sourceRed + tap);
+				tapGreen = _mm256_loadu_ps(pass.sourceGreen + tap);
+				tapBlue = _mm256_loadu_ps(pass.sourceBlue + tap);
+
+				__m256 lumaDifference = _mm256_sub_ps(luminance8(tapRed, tapGreen, tapBlue), centerLuma);
+				__m256 depthDifference = _mm256_and_ps(_mm256_sub_ps(_mm256_loadu_ps(pass.depth + tap), centerDepth), absMask);
+				__m256 normalWeight = _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(_mm256_loadu_ps(pass.normalX + tap), centerNormalX),
+					_mm256_mul_ps(_mm256_loadu_ps(pass.normalY + tap), centerNormalY)),
+					_mm256_mul_ps(_mm256_loadu_ps(pass.normalZ + tap), centerNormalZ));
+				normalWeight = _mm256_max_ps(normalWeight, _mm256_setzero_ps());
+				for (int i = 0; i < pass.normalSquarings; i++) normalWeight = _mm256_mul_ps(normalWeight, normalWeight);
+
+				__m256 exponent = _mm256_sub_ps(
+					_mm256_mul_ps(_mm256_mul_ps(lumaDifference, lumaDifference), negativeInverseColorSigmaSquared),
+					_mm256_mul_ps(depthDifference, depthScale));
+				weight = _mm256_mul_ps(_mm256_mul_ps(kernelWeight, normalWeight), fastExp8(exponent));
+			}
+
+			sumRed = _mm256_add_ps(sumRed, _mm256_mul_ps(tapRed, weight));
+			sumGreen = _mm256_add_ps(sumGreen, _mm256_mul_ps(tapGreen, weight));
+			sumBlue = _mm256_add_ps(sumBlue, _mm256_mul_ps(tapBlue, weight));
+			sumWeight = _mm256_add_ps(sumWeight, weight);
+		}
+	}
+
+	_mm256_storeu_ps(pass.destinationRed + center, _mm256_div_ps(sumRed, sumWeight));
+	_mm256_storeu_ps(pass.destinationGreen + center, _mm256_div_ps(sumGreen, sumWeight));
+	_mm256_storeu_ps(pass.destinationBlue + center, _mm256_div_ps(sumBlue, sumWeight));
+}
+#endif
+
+static void filterRow(const DenoiserPass & pass, int y) {
+	int x = 0;
+#ifdef __AVX2__
+	//Rows whose taps all land inside the image go 8 pixels at a time, except near the left and right edges
+	int reach = 2 * pass.step;
+	if (y >= reach && y < pass.height - reach) {
+		for (; x < reach; x++) filterPixelScalar(pass, x, y);
+		for (; x + 8 <= pass.width - reach; x += 8) filterPixels8(pass, x, y);
+	}
+#endif
+	for (; x < pass.width; x++) filterPixelScalar(pass, x, y);
+}
+
+//Holds threads until all of them have arrived, then lets them all go, ready to be used again for the next pass.
+class DenoiserBarrier {
+public:
+	explicit DenoiserBarrier(int threadCount) : threadCount(threadCount), waiting(0), generation(0) {}
+
+	void arriveAndWait() {
+		std::unique_lock<std::mutex> lock(mutex);
+		int arrivedGeneration = generation;
+		if (++waiting == threadCount) {
+			waiting = 0;
+			generation++;
+			allArrived.notify_all();
+			return;
+		}
+		allArrived.wait(lock, [&]() { return generation != arrivedGeneration; });
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable allArrived;
+	int threadCount;
+	int waiting;
+	int generation;
+};
+
+void denoiseFrame(const DenoiserFrame & frame, const DenoiserSettings & settings) {
+	int pixelCount = frame.width * frame.height;
+	std::vector<float> scratchRed(pixelCount);
+	std::vector<float> scratchGreen(pixelCount);
+	std::vector<float> scratchBlue(pixelCount);
+
+	int threadCount = settings.threadCount > 0 ? settings.threadCount : std::max((int)std::thread::hardware_concurrency(), 1);
+	int bandCount = (frame.height + denoiserBandRows - 1) / denoiserBandRows;
+
+	//Every pass is worked out up front, so the threads can go from one to the next without coming back here
+	std::vector<DenoiserPass> passes(std::max(settings.iterations, 0));
+	float colorSigma = settings.colorSigma;
+	for (int iteration = 0; iteration < settings.iterations; iteration++) {
+		DenoiserPass & pass = passes[iteration];
+		pass.width = frame.width;
+		pass.height = frame.height;
+		pass.depth = frame.depth;
+		pass.normalX = frame.normalX;
+		pass.normalY = frame.normalY;
+		pass.normalZ = frame.normalZ;
+		pass.normalSquarings = settings.normalSquarings;
+		pass.step = 1 << iteration;
+		pass.inverseColorSigmaSquared = 1.0f / (colorSigma * colorSigma);
+		pass.inverseDepthSigmaStep = 1.0f / (settings.depthSigma * pass.step);
+		colorSigma *= 0.5f;
+
+		//Even passes go from the frame into the scratch planes, odd ones back again
+		bool intoScratch = iteration % 2 == 0;
+		pass.sourceRed = intoScratch ? frame.red : &scratchRed[0];
+		pass.sourceGreen = intoScratch ? frame.green : &scratchGreen[0];
+		pass.sourceBlue = intoScratch ? frame.blue : &scratchBlue[0];
+		pass.destinationRed = intoScratch ? &scratchRed[0] : frame.red;
+		pass.destinationGreen = intoScratch ? &scratchGreen[0] : frame.green;
+		pass.destinationBlue = intoScratch ? &scratchBlue[0] : frame.blue;
+	}
+
+	//The threads are started once for the whole frame. Within a pass, they take bands of rows off that pass's counter until there are
+	//none left, then wait for each other, since the next pass reads what this one wrote.
+	std::unique_ptr<std::atomic<int>[]> nextBands(new std::atomic<int>[passes.size() + 1]);
+	for (size_t i = 0; i < passes.size(); i++) nextBands[i] = 0;
+	DenoiserBarrier passFinished(threadCount);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threadCount; t++) {
+		threads.push_back(std::thread([&]() {
+			for (size_t i = 0; i < passes.size(); i++) {
+				int band;
+				while ((band = nextBands[i]++) < bandCount) {
+					int lastRow = std::min((band + 1) * denoiserBandRows, frame.height);
+					for (int y = band * denoiserBandRows; y < lastRow; y++) filterRow(passes[i], y);
+				}
+				passFinished.arriveAndWait();
+			}
+		}));
+	}
+	for (std::thread & thread : threads) thread.join();
+
+	//An odd number of passes leaves the result in the scratch planes
+	if (settings.iterations % 2 == 1) {
+		memcpy(frame.red, &scratchRed[0], pixelCount * sizeof(float));
+		memcpy(frame.green, &scratchGreen[0], pixelCount * sizeof(float));
+		memcpy(frame.blue, &scratchBlue[0], pixelCount * sizeof(float));
+	}
+}
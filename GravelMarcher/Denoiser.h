@@ -0,0 +1,43 @@
+#pragma once
+
+//An edge-aware a-trous wavelet denoiser, for cleaning up frames rendered with only a few samples per pixel.
+//Each pass blurs with a 5x5 B3 spline kernel whose taps get further apart every pass, so five passes cover an 81 pixel wide footprint.
+//Taps are weighted down when their depth, normal or color differs from the center pixel's, so edges stay sharp while flat noisy areas get smoothed.
+//The inner loop is AVX2 when the compiler is allowed it, and the image is split into bands of rows that are filtered on several threads at once.
+
+struct DenoiserSettings {
+	//How many passes to run. Each one doubles the distance between taps.
+	int iterations;
+
+	//How different, in luminance, a tap can be before it stops counting. Halved every pass, since each pass leaves less noise.
+	float colorSigma;
+
+	//How different a tap's depth can be, as a fraction of the center pixel's depth per pixel of distance.
+	float depthSigma;
+
+	//A tap's weight is the dot product of its normal with the center pixel's, squared this many times. Higher means sharper creases.
+	int normalSquarings;
+
+	//How many threads to filter with. 0 means one per hardware thread.
+	int threadCount;
+};
+
+//Sensible settings for a handful of samples per pixel.
+DenoiserSettings defaultDenoiserSettings();
+
+//A frame to denoise, stored planar: each channel is its own array of width * height floats, one row after another.
+//Depth is the distance the camera ray traveled. Normals are unit length, or zero where the ray hit nothing.
+struct DenoiserFrame {
+	int width;
+	int height;
+	float * red;
+	float * green;
+	float * blue;
+	const float * depth;
+	const float * normalX;
+	const float * normalY;
+	const float * normalZ;
+};
+
+//Denoises the frame's color in place.
+void denoiseFrame(const DenoiserFrame & frame, const DenoiserSettings & settings);
@@ -2,143 +2,96 @@
 
 #define PI 3.1415926535897932384626433832795
 
-#define STOP_MODE_TOO_FAR 0
-#define STOP_MODE_MAX_ITERS 1
-#define STOP_MODE_CLOSE_ENOUGH 2
-
 in vec3 rayView;
+flat in int viewIndex;
 
 //-----------------------------Shader uniforms------------------------------------------
 
-//A 4x4 matrix representing the affine transformation from camera space to world space.
-//This should move the point (0, 0, 0) to the camera position, as well as apply any rotations.
-//It should also not contain any scaling component. That would break everything.
-uniform mat4 matCameraToWorld;
-
-//------------------------Color uniforms-----------------------------------------------
-//These colors are given by the CPU program, and change through the course of the 'music video'
-uniform vec3 ballsDiffuse;
-uniform vec3 ballsSpecular;
-uniform float ballsShininess;
+//Everything that changes from frame to frame comes in the FrameParams block.
+#include "FrameParams.glsl"
 
-uniform vec3 floorDiffuse;
-uniform vec3 floorSpecular;
-uniform float floorShininess;
+//The sky, as seen from every direction. SkyLUT.glsl fills it in whenever the sun changes.
+layout(binding = 3) uniform sampler2D skyLUT;
+#include "SkyLUTMapping.glsl"
+#include "VariableRate.glsl"
+#include "Checkerboard.glsl"
+#include "Scene.glsl"
+#include "Shading.glsl"
+#include "Lights.glsl"
+#include "TileCulling.glsl"
 
-uniform vec3 ambientLight;
-uniform bool doLambertian;
 
-uniform vec3 sunDirection;
-uniform vec3 skyColor;
-uniform vec3 sunColor;
-uniform float sunShininess;
-uniform float sunOverSat;
+//----------------------------------Shader outputs-----------------------------------------
+//Each of these goes to its own render target, so passes after the marcher can see what it found.
 
 //Simply outputs the rgb-normalized color of this pixel.
-out vec3 color;
-
-//--------------------------------Shader variables--------------------------------------
-
-//Calculates the direction of the ray in world space
-//This vector represents a direction, and has a length of 1.
-vec3 rayWorld;
-
-//The point that the SDF is 'sampled' at. Changes as the ray marches forward. Starts at the camera position
-vec3 testPoint;
+layout(location = 0) out vec3 color;
 
-//The point that the SDF is sampled at, modified to reflect the deformation of space.
-vec3 testPointDeformed;
+//How far the camera ray went before it stopped, for whatever reason.
+layout(location = 1) out float hitDistance;
 
-vec3 cameraPosition;
+//1 if the sun reaches the point the camera ray hit, 0 if it's in shadow. The sky counts as lit.
+layout(location = 2) out float sunVisibility;
 
-int i;
+//How many steps the camera ray took.
+layout(location = 3) out uint marchSteps;
 
+//The normal of the surface the camera ray hit, octahedral encoded. (0, 0) for the sky.
+layout(location = 4) out vec2 hitNormal;
 
-//----------------------------------Shader technical constants-----------------------------------
+//How much of color is the ambient light, after fog. Ssao.glsl takes the occluded part of it back out. (0, 0, 0) for the sky.
+layout(location = 5) out vec3 hitAmbient;
 
-//How close the ray has to march to the SDF until it's considered 'on' it.
-const float camRayCloseEnough = 0.001f;
+#include "MarchStats.glsl"
 
-//How far from the camera the ray stops marching. (This should also be when the 'fog' hits 1)
-const float camRayTooFar = 1000.0f;
+//-----------------------------Progressive accumulation-----------------------------------
+//For final quality frames, the same frame is drawn over and over with random soft shadows, sky light and ambient occlusion,
+//and the samples are averaged. Each pixel stops taking samples once its average stops changing much.
 
-//The maximum number of marching steps the SLDF can take before it just gives the sky color
-const uint camRayMaxSteps = 4000;
+//Whether this pass is one sample of a progressive frame.
+uniform bool progressiveEnabled;
 
-//The maximum number of steps to take while shadow marching. Should be much lower than the actual max steps.
-const uint shadowRayMaxSteps = 100;
+//Which sample this pass is. Seeds the random numbers, so every sample is different.
+uniform uint progressiveSampleIndex;
 
-const float shadowRayTooFar = 100.0f;
+//A pixel always takes at least this many samples before it can be considered converged, so its variance estimate means something.
+uniform uint progressiveMinSamples;
 
-//---------------------------------Shader geometry constants----------------------------
+//A pixel is converged once the standard error of its mean luminance is under this fraction of the mean.
+uniform float progressiveVarianceThreshold;
 
-const float sphereRadius = 1.0f;
-const vec3 sphereCenter = vec3(0, 0, 0);
+//The sum of every sample so far in rgb, and how many samples there have been in a.
+layout(rgba32f, binding = 0) uniform image2D accumulation;
 
-const vec3 floorNormal = vec3(0, 1, 0);
-const float floorOffset = -1.0f;
+//The sum of every sample's luminance squared, for the variance.
+layout(r32f, binding = 1) uniform image2D accumulationLumaSquares;
 
-vec3 deformation(vec3 p) {
-	//return p;
-	return mod(p + vec3(2, 0, 2), vec3(4, 0, 4)) - vec3(2, 0, 2);
-}
+//How wide the sun is, in radians from its center. This is what makes the shadows soft.
+const float sunAngularRadius = 0.03f;
 
-//This is a function that determines how the fog falls off with distance.
-//Different functions can give very different feels to a scene.
-float fogFalloff(float d) {
-	return d;
-}
+//Sky light rays only look nearby, since that's where the occlusion that matters is.
+const uint skyRayMaxSteps = 64;
+const float skyRayTooFar = 20.0f;
 
-//-----------------------------------SDF Output variables---------------------------------------
-//These are modified (really set) as the SDF evaluates, then other parts of the program can look at them to see what's up
+//--------------------------------Shader variables--------------------------------------
 
-//The actual value of the SDF. Represents a lower bound on the distance from the point the SDF was evaluated at, to the nearest geometry.
-//The sign is significant. Positive means the point is outside an object, negative means inside, 0 means it's on a surface.
-float sdfValue;
+//Calculates the direction of the ray in world space
+//This vector represents a direction, and has a length of 1.
+vec3 rayWorld;
 
-//The normal of the surface closest to the point the SDF was evaluated at.
-vec3 surfaceNormal;
+//The point that the SDF is 'sampled' at. Changes as the ray marches forward. Starts at the camera position
+vec3 testPoint;
 
-//The diffuse color of the surface closest to the point the SDF was evaluated at.
-vec3 surfaceDiffuse;
+//The point that the SDF is sampled at, modified to reflect the deformation of space.
+vec3 testPointDeformed;
 
-//The specular color of blah blah blah
-vec3 surfaceSpecular;
+vec3 cameraPosition;
 
-//The specular exponent (shininess) of the surface
-float surfaceShininess;
+int i;
 
-//The actual SDF. This is where the real meat of the scene is. By changing this function, the whole scene can be changed.
-void sdf(vec3 p, bool includeColorCalcs) {
-	
-	//First applies the space deformation.
-	vec3 pp = deformation(p);
-
-	vec3 ppc = pp - sphereCenter;
-	float sdfSphereValue = length(ppc) - sphereRadius;
-	float sdfPlaneValue = dot((pp - floorOffset * floorNormal), floorNormal);
-
-	if(sdfSphereValue < sdfPlaneValue) {
-		sdfValue = sdfSphereValue;
-		if(!includeColorCalcs) return;
-
-		//The coloring data. Only needed if includeColorCalcs was true.
-		surfaceNormal = normalize(ppc);
-		surfaceDiffuse = ballsDiffuse;
-		surfaceSpecular = ballsSpecular;
-		surfaceShininess = ballsShininess;
-
-	} else {
-		sdfValue = sdfPlaneValue;
-		if(!includeColorCalcs) return;
-
-		surfaceNormal = floorNormal;
-		surfaceDiffuse = floorDiffuse;
-		surfaceSpecular = floorSpecular;
-		surfaceShininess = floorShininess;
-	}
 
-}
+//----------------------------------Shader technical constants-----------------------------------
+//The marching limits, the geometry constants, deformation() and sdf() all live in Scene.glsl, since tile culling and wavefront mode need them too.
 
 //---------------------------march output variables----------------------------------
 //These are set each time the march function is run.
@@ -179,24 +132,154 @@ void march(vec3 origin, vec3 direction, float closeEnough, float tooFar, uint ma
 	marchStopMode = STOP_MODE_MAX_ITERS;
 }
 
+//--------------------------------Random numbers------------------------------------------
+
+uint rngState;
+
+//The PCG hash. Good enough randomness for sampling, and cheap.
+uint pcgHash(uint v) {
+	uint state = v * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+//A random number in [0, 1).
+float random01() {
+	rngState = pcgHash(rngState);
+	return float(rngState) / 4294967296.0f;
+}
+
+//Any two vectors that, along with n, make an orthonormal basis.
+void orthonormalBasis(vec3 n, out vec3 tangent, out vec3 bitangent) {
+	tangent = normalize(abs(n.x) > 0.5f ? cross(n, vec3(0, 1, 0)) : cross(n, vec3(1, 0, 0)));
+	bitangent = cross(n, tangent);
+}
+
+//A random direction within halfAngle radians of axis, with every direction in the cone equally likely.
+vec3 sampleCone(vec3 axis, float halfAngle) {
+	float cosTheta = mix(1.0f, cos(halfAngle), random01());
+	float sinTheta = sqrt(1.0f - cosTheta * cosTheta);
+	float phi = 2 * PI * random01();
+	vec3 tangent, bitangent;
+	orthonormalBasis(axis, tangent, bitangent);
+	return normalize(axis * cosTheta + (tangent * cos(phi) + bitangent * sin(phi)) * sinTheta);
+}
+
+//A random direction on the hemisphere around n, more likely the closer it is to n, in proportion to its cosine.
+vec3 sampleCosineHemisphere(vec3 n) {
+	float r = sqrt(random01());
+	float phi = 2 * PI * random01();
+	vec3 tangent, bitangent;
+	orthonormalBasis(n, tangent, bitangent);
+	return normalize(n * sqrt(1.0f - r * r) + (tangent * cos(phi) + bitangent * sin(phi)) * r);
+}
+
+float luminance(vec3 c) {
+	return dot(c, vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+//Adds this pass's color to the pixel's running sums, then outputs the average so far instead.
+void accumulateSample() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec4 sum = imageLoad(accumulation, pixel) + vec4(color, 1);
+	float lumaSquares = imageLoad(accumulationLumaSquares, pixel).r + luminance(color) * luminance(color);
+	imageStore(accumulation, pixel, sum);
+	imageStore(accumulationLumaSquares, pixel, vec4(lumaSquares));
+	color = sum.rgb / sum.a;
+}
+
+//The ray, in view space, through a point on the screen given in pixels. The same ray the screen quad interpolates there.
+vec3 rayViewThrough(vec2 screenPosition) {
+	return vec3((screenPosition / vec2(targetSize) * 2 - 1) * vec2(screenRight, screenTop), -1);
+}
+
 //The main function assembles and coordinates all the other functions to actually draw colors.
 void main() {
+
+	//How much the view ray changes from one pixel to the next. Found before anything can discard, since derivatives need every pixel around.
+	vec3 rayViewPerPixelX = dFdx(rayView);
+	vec3 rayViewPerPixelY = dFdy(rayView);
+	vec3 pixelRayView = rayView;
+
+	//The pixel this fragment marches. It's where the fragment is, unless a mode packs the pixels it marches together.
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+	//In checkerboard mode, only this frame's half of the pixels are drawn, packed into the left half of the targets. See Checkerboard.glsl.
+	//The quad's ray doesn't go through the pixel being marched, so it's aimed from scratch. CheckerboardResolve.glsl fills in the other half.
+	if(checkerboardEnabled) {
+		pixel = checkerboardPixel(pixel);
+		if(pixel.x >= targetSize.x) {
+			discard;
+		}
+		pixelRayView = rayViewThrough(vec2(pixel) + 0.5f);
+	}
+
+	//In variable-rate mode, each fragment marches a whole block, packed into its tile's corner. See VariableRate.glsl.
+	//It looks through the middle of the block, and VariableRateResolve.glsl spreads it over the rest.
+	if(variableRateEnabled) {
+		int blockSize = variableRateBlockSize(pixel);
+		pixel = variableRateBlockOrigin(pixel);
+		if(any(greaterThanEqual(pixel, targetSize))) {
+			discard;
+		}
+		pixelRayView = rayViewThrough(vec2(pixel) + blockSize * 0.5f);
+	}
 	
+	//In progressive mode, converged pixels stop taking samples. The rest count themselves, so the CPU knows when to stop.
+	if(progressiveEnabled) {
+		vec4 sum = imageLoad(accumulation, pixel);
+		if(sum.a >= float(progressiveMinSamples)) {
+			float mean = luminance(sum.rgb / sum.a);
+			float variance = max(imageLoad(accumulationLumaSquares, pixel).r / sum.a - mean * mean, 0.0f);
+			if(sqrt(variance / sum.a) <= progressiveVarianceThreshold * max(mean, 0.01f)) {
+				discard;
+			}
+		}
+		atomicAdd(progressiveActivePixels, 1);
+
+		//Each sample looks through a different random spot inside the pixel, which antialiases for free
+		rngState = pcgHash(uint(pixel.x) ^ pcgHash(uint(pixel.y) ^ pcgHash(progressiveSampleIndex)));
+		pixelRayView += rayViewPerPixelX * (random01() - 0.5f) + rayViewPerPixelY * (random01() - 0.5f);
+	}
+
+	//In multi-view rendering, each view is its own camera, placed relative to the real one.
+	mat4 matViewToWorld = matCameraToWorld * matViewToCamera[viewIndex];
+
 	//The ray for this pixel is the normalized, interpolated ray from the vertices of the screen quad.
-	rayWorld = normalize((matCameraToWorld * vec4(rayView, 0)).xyz);
+	rayWorld = normalize((matViewToWorld * vec4(pixelRayView, 0)).xyz);
 
 	//Finds the camera position
-	cameraPosition = (matCameraToWorld * vec4(0, 0, 0, 1)).xyz;
+	cameraPosition = (matViewToWorld * vec4(0, 0, 0, 1)).xyz;
+
+	//Tile culling already proved every ray in this tile misses everything up to tileStart, so the march starts there.
+	//If it got all the way to camRayTooFar, it's sky, and there's nothing to march.
+	float tileStart = tileCullEnabled ? tileStartDistance(pixel) : 0.0f;
+	if(tileStart >= camRayTooFar) {
+		marchEndPoint = cameraPosition + rayWorld * tileStart;
+		marchIterCount = 0;
+		marchStopMode = STOP_MODE_TOO_FAR;
+	}
+	else {
+		//Does the initial camera-ray marching.
+		march(cameraPosition + rayWorld * tileStart, rayWorld, camRayCloseEnough, camRayTooFar - tileStart, camRayMaxSteps, true);
+	}
 
-	//Does the initial camera-ray marching.
-	march(cameraPosition, rayWorld, camRayCloseEnough, camRayTooFar, camRayMaxSteps, true);
+	hitDistance = length(marchEndPoint - cameraPosition);
+	marchSteps = marchIterCount;
+	sunVisibility = 1.0f;
+	hitNormal = vec2(0, 0);
+	hitAmbient = vec3(0, 0, 0);
+
+	if(collectMarchStats) {
+		countCameraRay(marchIterCount, marchStopMode);
+	}
 
 	//If the ray ended because it got too far or hit max iters, draw the sky.
 	if(marchStopMode == STOP_MODE_TOO_FAR) {
-		color = 
-			skyColor +
-			pow(max(dot(sunDirection, rayWorld), 0.0f), sunShininess) * sunOverSat * sunColor
-		;
+		color = textureLod(skyLUT, skyLUTCoordinates(rayWorld), 0).rgb;
+		if(progressiveEnabled) {
+			accumulateSample();
+		}
 		return;
 	}
 
@@ -207,6 +290,7 @@ void main() {
 	vec3 camRayHitDiffuse = surfaceDiffuse;
 	vec3 camRayHitSpecular = surfaceSpecular;
 	float camRayHitShininess = surfaceShininess;
+	hitNormal = octahedralEncode(camRayHitNormal);
 
 	//Corrects the camRayHitPoint. This helps avoid shadow weirdness at glancing angles.
 	if(marchStopMode == STOP_MODE_CLOSE_ENOUGH){
@@ -217,32 +301,63 @@ void main() {
 	//Assume it is unless shown otherwise.
 	bool isInShadow = true;
 
+	//In progressive mode, the shadow ray heads for a random spot on the sun's disc. Averaged over many samples, that makes soft shadows.
+	vec3 shadowDirection = progressiveEnabled ? sampleCone(sunDirection, sunAngularRadius) : sunDirection;
+
 	//Only shadow march if the object isn't shadowing itself, i.e, its normal is facing away from the sun.
-	if(dot(camRayHitNormal, sunDirection) > 0) {
-		march(camRayHitPoint + sunDirection * 0.01, sunDirection, 0.0, shadowRayTooFar, shadowRayMaxSteps, false);
+	if(dot(camRayHitNormal, shadowDirection) > 0) {
+		march(camRayHitPoint + shadowDirection * 0.01, shadowDirection, 0.0, shadowRayTooFar, shadowRayMaxSteps, false);
+		if(collectMarchStats) {
+			atomicAdd(marchShadowRays, 1);
+		}
 		//If the ray made it to 'infinity,' we know the object is lit. This is the only case in which it's lit.
 		if(marchStopMode == STOP_MODE_TOO_FAR){
 			isInShadow = false;
 		}
 	}
+	sunVisibility = isInShadow ? 0.0f : 1.0f;
 
 	//Only apply the non-ambient light if the point isn't in shadow.
 	vec3 lightingComponent = vec3(0, 0, 0);
 	if(!isInShadow) {
-		vec3 halfway = normalize(normalize(cameraPosition - camRayHitPoint) + sunDirection);
-		lightingComponent = 
-			/*The diffuse component*/	camRayHitDiffuse * max(dot(camRayHitNormal, sunDirection), 0.0f) + 
-			/*The specular component*/	camRayHitSpecular * pow(max(dot(halfway, camRayHitNormal), 0.0f), camRayHitShininess)
-		;
-		if(!doLambertian){
-			lightingComponent = camRayHitDiffuse;
-		}
+		lightingComponent = sunLighting(camRayHitPoint, cameraPosition, camRayHitNormal, camRayHitDiffuse, camRayHitSpecular, camRayHitShininess);
+	}
+
+	//The point lights go on top, whether or not the sun's blocked
+	uint pointShadowRays;
+	float viewDepth = -(matWorldToView * vec4(camRayHitPoint, 1)).z;
+	lightingComponent += pointLighting(pixel, viewDepth, camRayHitPoint, cameraPosition,
+		camRayHitNormal, camRayHitDiffuse, camRayHitSpecular, camRayHitShininess, pointShadowRays);
+	if(collectMarchStats) {
+		atomicAdd(marchShadowRays, pointShadowRays);
+	}
+
+	//The flat ambient light, everywhere.
+	vec3 ambientComponent = camRayHitDiffuse * ambientLight;
+
+	//In progressive mode, ambient and sky light come from a random direction over the hemisphere instead, and only if nothing's in the way.
+	//Averaged over many samples, that gives ambient occlusion and light from the sky.
+	if(progressiveEnabled) {
+		vec3 skyRayDirection = sampleCosineHemisphere(camRayHitNormal);
+		march(camRayHitPoint + camRayHitNormal * 0.01, skyRayDirection, camRayCloseEnough, skyRayTooFar, skyRayMaxSteps, false);
+		float skyVisibility = marchStopMode == STOP_MODE_CLOSE_ENOUGH ? 0.0f : 1.0f;
+		ambientComponent = camRayHitDiffuse * (ambientLight + skyColor) * skyVisibility;
 	}
 
+	float fog = fogFalloff(length(cameraPosition - camRayHitPoint) / camRayTooFar);
 	color = mix(
-		camRayHitDiffuse * ambientLight + lightingComponent,
+		ambientComponent + lightingComponent,
 		skyColor,
-		fogFalloff(length(cameraPosition - camRayHitPoint) / camRayTooFar)
+		fog
 	);
 
+	//Progressive mode's ambient is already occluded, by its sky rays
+	if(!progressiveEnabled) {
+		hitAmbient = ambientComponent * (1 - fog);
+	}
+
+	if(progressiveEnabled) {
+		accumulateSample();
+	}
+
 }
\ No newline at end of file
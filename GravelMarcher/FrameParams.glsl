@@ -0,0 +1,112 @@
+//The per-frame parameter block, shared by every shader that #includes this file.
+//Everything here changes from frame to frame, so it all comes in one block the CPU writes straight into a mapped buffer.
+//The layout has to match the FrameParams struct in Main.cpp exactly. std140 pads every vec3 out to 16 bytes, so a float or bool can sit in the gap after one.
+
+//Main.cpp's defines of the same names have to match. A froxel holds its lights as bits of a uint, so there can't be more than 32.
+#define MAX_POINT_LIGHTS 32
+#define MAX_POINT_LIGHT_SHADOW_BUDGET 4
+
+//AudioSpectrum.h's AUDIO_SPECTRUM_BANDS has to match, and be a multiple of 4
+#define AUDIO_BAND_COUNT 16
+
+layout(std140, binding = 0) uniform FrameParams {
+	//A 4x4 matrix representing the affine transformation from camera space to world space.
+	//This should move the point (0, 0, 0) to the camera position, as well as apply any rotations.
+	//It should also not contain any scaling component. That would break everything.
+	mat4 matCameraToWorld;
+
+	//------------------------Color uniforms-----------------------------------------------
+	//These colors are given by the CPU program, and change through the course of the 'music video'
+	vec3 ballsDiffuse;
+	float ballsShininess;
+	vec3 ballsSpecular;
+	float floorShininess;
+
+	vec3 floorDiffuse;
+	float sunShininess;
+	vec3 floorSpecular;
+	float sunOverSat;
+
+	vec3 ambientLight;
+	bool doLambertian;
+
+	vec3 sunDirection;
+	vec3 skyColor;
+	vec3 sunColor;
+
+	//------------------------Reprojection uniforms----------------------------------------
+
+	//The inverse of last frame's matCameraToWorld. Takes a world space point to where last frame's camera saw it.
+	mat4 matWorldToPreviousCamera;
+
+	//If the screen is 1 unit away from the camera, these are the distances from its center to its top and right edges.
+	float screenTop;
+	float screenRight;
+
+	//Whether the marcher only marches half the pixels, in a checkerboard that flips every frame.
+	bool checkerboardEnabled;
+
+	//Which half of the checkerboard gets marched this frame. Pixels where (x + y + checkerboardPhase) is even are marched.
+	int checkerboardPhase;
+
+	//------------------------Multi-view uniforms------------------------------------------
+
+	//Where each view sits relative to the camera. View i is instance i of the screen quad, and goes to layer i of the render targets.
+	//Sized to MAX_VIEWS in Main.cpp. Only the first viewCount are set.
+	mat4 matViewToCamera[6];
+	int viewCount;
+
+	//------------------------Variable-rate uniforms---------------------------------------
+
+	//Whether tiles march at the rates in the rate map, rather than every pixel marching. See VariableRate.glsl.
+	bool variableRateEnabled;
+
+	//Whether the rate map also gets coarser toward the edges of the screen.
+	bool variableRateFoveated;
+
+	//Whether tiles are tinted by their rate, to see what the rate map is doing.
+	bool variableRateDebugView;
+
+	//------------------------Tile culling uniforms----------------------------------------
+
+	//Whether the marcher starts its rays where TileCull.glsl says they can. See TileCulling.glsl.
+	bool tileCullEnabled;
+
+	//------------------------Wavefront uniforms-------------------------------------------
+
+	//Whether the frame is marched by the wavefront stages instead of the fragment marcher. See WavefrontQueues.glsl.
+	bool wavefrontEnabled;
+
+	//------------------------Render target uniforms---------------------------------------
+
+	//How many pixels across and down the marcher's render targets are. Modes that don't draw every pixel where it is use it to aim their rays.
+	ivec2 targetSize;
+
+	//------------------------Point light uniforms-----------------------------------------
+
+	//Takes world space to view 0's space, which the point lights are clustered in. See Lights.glsl.
+	mat4 matWorldToView;
+
+	//Where each point light is, in xyz, and its color, in rgb. Only the first pointLightCount are set.
+	vec4 pointLightPositions[MAX_POINT_LIGHTS];
+	vec4 pointLightColors[MAX_POINT_LIGHTS];
+	int pointLightCount;
+
+	//How many of the point lights on a pixel get a shadow ray. No more than MAX_POINT_LIGHT_SHADOW_BUDGET.
+	int pointLightShadowBudget;
+
+	//------------------------Ambient occlusion uniforms-----------------------------------
+
+	//Whether Ssao.glsl darkens the ambient light after marching. The marcher writes the ambient out either way.
+	bool ssaoEnabled;
+
+	//------------------------Audio uniforms-----------------------------------------------
+
+	//How loud the music is right now in each band, from 0 to 1, lowest first and four to a vec4. Read with audioBand.
+	//All 0 if the spectrum hasn't been baked. See AudioSpectrum.h.
+	vec4 audioBands[AUDIO_BAND_COUNT / 4];
+};
+
+float audioBand(int band) {
+	return audioBands[band / 4][band % 4];
+}
@@ -0,0 +1,46 @@
+#version 460 core
+
+//Sorts the point lights into froxels. One thread does one froxel, and tests every light's sphere of reach against the box around the froxel.
+//The box is in view space with depth measured forward, so a light's view space position just has its z flipped to compare.
+//See Lights.glsl.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+#include "FrameParams.glsl"
+#include "Scene.glsl"
+#include "Lights.glsl"
+
+//Only here for its size, which is the size of the screen.
+layout(binding = 0) uniform sampler2D depthTarget;
+
+void main() {
+	uvec3 froxel = gl_GlobalInvocationID;
+	if(froxel.x >= clusterTilesWide || froxel.y >= clusterTilesHigh) return;
+
+	//The froxel's edges, from -1 to 1 across the screen like the screen quad, and its nearest and furthest depths
+	vec2 screenSize = vec2(textureSize(depthTarget, 0));
+	vec2 tileLow = vec2(froxel.xy * LIGHT_CLUSTER_TILE_SIZE) / screenSize * 2 - 1;
+	vec2 tileHigh = min(vec2((froxel.xy + 1) * LIGHT_CLUSTER_TILE_SIZE) / screenSize, 1.0f) * 2 - 1;
+	float nearDepth = froxel.z == 0 ? 0.0f : lightClusterSliceDepth(froxel.z);
+	float farDepth = lightClusterSliceDepth(froxel.z + 1);
+
+	//The edges go out from the camera, so the box's sides are wherever they are at whichever depth reaches further
+	vec2 screenExtent = vec2(screenRight, screenTop);
+	vec2 nearLow = tileLow * screenExtent * nearDepth;
+	vec2 farLow = tileLow * screenExtent * farDepth;
+	vec2 nearHigh = tileHigh * screenExtent * nearDepth;
+	vec2 farHigh = tileHigh * screenExtent * farDepth;
+	vec3 boxMin = vec3(min(nearLow, farLow), nearDepth);
+	vec3 boxMax = vec3(max(nearHigh, farHigh), farDepth);
+
+	uint lightMask = 0;
+	for(int light = 0; light < pointLightCount; light++) {
+		vec3 lightView = (matWorldToView * vec4(pointLightPositions[light].xyz, 1)).xyz;
+		lightView.z = -lightView.z;
+		vec3 nearest = clamp(lightView, boxMin, boxMax);
+		if(length(nearest - lightView) < pointLightRadius) {
+			lightMask |= 1u << light;
+		}
+	}
+	froxelLightMasks[lightClusterIndex(froxel.xy, froxel.z)] = lightMask;
+}
@@ -0,0 +1,156 @@
+//---------------------------------Point lights-------------------------------------------
+//The point lights, and the clusters LightCull.glsl sorts them into. The view is cut into froxels, tiles of the screen split
+//up by depth, and each froxel gets a mask of the lights that can reach anything inside it. A pixel only looks at its own froxel's lights.
+//Has to come after FrameParams.glsl and Scene.glsl. Main.cpp's LIGHT_CLUSTER_* defines have to match.
+
+//Froxels are this many pixels square
+#define LIGHT_CLUSTER_TILE_SIZE 32
+
+//How many slices the view is cut into by depth. They get thicker further out, so each one's far end is the same multiple of its near end.
+#define LIGHT_CLUSTER_SLICES 24
+const float lightClusterNear = 0.5f;
+const float lightClusterFar = camRayTooFar;
+
+//A point light only reaches this far. Past it, it's cut off to nothing, so it can be left out of froxels it can't reach.
+//Main.cpp's pointLightRadius has to match.
+const float pointLightRadius = 4.0f;
+
+//A shadow ray to a point light steps at most this many times. Like sun shadows, running out counts as shadowed.
+const uint pointShadowRayMaxSteps = 64;
+
+layout(std430, binding = 5) buffer LightClusters {
+	//How many froxels across and down the screen is. Set when the render targets are made.
+	uint clusterTilesWide;
+	uint clusterTilesHigh;
+
+	//One per froxel, bit i set if point light i can reach it. The slice is the slowest changing, then the row.
+	uint froxelLightMasks[];
+};
+
+//The slice a point this far in front of the camera is in. Anything nearer than lightClusterNear is in the first.
+uint lightClusterSlice(float depth) {
+	float slice = log(max(depth, lightClusterNear) / lightClusterNear) / log(lightClusterFar / lightClusterNear) * LIGHT_CLUSTER_SLICES;
+	return min(uint(slice), uint(LIGHT_CLUSTER_SLICES - 1));
+}
+
+//How far in front of the camera a slice starts. Slice LIGHT_CLUSTER_SLICES is where the last one ends.
+float lightClusterSliceDepth(uint slice) {
+	return lightClusterNear * pow(lightClusterFar / lightClusterNear, float(slice) / LIGHT_CLUSTER_SLICES);
+}
+
+uint lightClusterIndex(uvec2 tile, uint slice) {
+	return (slice * clusterTilesHigh + tile.y) * clusterTilesWide + tile.x;
+}
+
+//How much of its light a point light puts out at this distance. Falls off with the square of the distance, and windowed so it
+//gets to exactly nothing at pointLightRadius.
+float pointLightFalloff(float lightDistance) {
+	float window = clamp(1.0f - pow(lightDistance / pointLightRadius, 4.0f), 0.0f, 1.0f);
+	return window * window / (lightDistance * lightDistance + 1.0f);
+}
+
+//The light a point light puts on a point, as if nothing were in the way.
+//A light behind the surface puts nothing on it, not even a highlight, so it never takes up a shadow ray either.
+vec3 unshadowedPointLighting(int light, vec3 hitPoint, vec3 eyePosition, vec3 normal, vec3 diffuse, vec3 specular, float shininess) {
+	vec3 toLight = pointLightPositions[light].xyz - hitPoint;
+	float lightDistance = length(toLight);
+	vec3 lightDirection = toLight / lightDistance;
+	float facing = dot(normal, lightDirection);
+	if(facing <= 0) {
+		return vec3(0, 0, 0);
+	}
+	vec3 halfway = normalize(normalize(eyePosition - hitPoint) + lightDirection);
+	return pointLightColors[light].rgb * pointLightFalloff(lightDistance) * (
+		/*The diffuse component*/	diffuse * facing +
+		/*The specular component*/	specular * pow(max(dot(halfway, normal), 0.0f), shininess)
+	);
+}
+
+//Whether a shadow ray from hitPoint gets all the way to the light without running into anything.
+bool pointLightReaches(int light, vec3 hitPoint) {
+	vec3 toLight = pointLightPositions[light].xyz - hitPoint;
+	float lightDistance = length(toLight);
+	vec3 lightDirection = toLight / lightDistance;
+	vec3 position = hitPoint + lightDirection * 0.01;
+	float travelled = 0.01f;
+	for(uint i = 0; i < pointShadowRayMaxSteps; i++) {
+		sdf(position, false);
+		if(sdfValue <= 0) {
+			return false;
+		}
+		travelled += sdfValue;
+		if(travelled >= lightDistance) {
+			return true;
+		}
+		position += sdfValue * lightDirection;
+	}
+	return false;
+}
+
+//Picks which of the lights in pixel's froxel get a shadow ray: the pointLightShadowBudget that would put the most light on the point.
+//The rest light it as if nothing were in the way, which mostly goes unnoticed since they're the dim ones.
+//Returns them as a mask, bit i set for light i. unshadowedLighting is the light every one of them puts on the point, with nothing in the way.
+uint choosePointLightShadowRays(ivec2 pixel, float depth, vec3 hitPoint, vec3 eyePosition, vec3 normal, vec3 diffuse, vec3 specular, float shininess,
+	out vec3 unshadowedLighting) {
+	unshadowedLighting = vec3(0, 0, 0);
+	if(pointLightCount == 0) {
+		return 0u;
+	}
+	uint lightMask = froxelLightMasks[lightClusterIndex(uvec2(pixel) / LIGHT_CLUSTER_TILE_SIZE, lightClusterSlice(depth))];
+
+	//Finds the brightest few, by how bright their light on the point is
+	int shadowedLights[MAX_POINT_LIGHT_SHADOW_BUDGET];
+	float shadowedBrightness[MAX_POINT_LIGHT_SHADOW_BUDGET];
+	for(int i = 0; i < MAX_POINT_LIGHT_SHADOW_BUDGET; i++) {
+		shadowedLights[i] = -1;
+		shadowedBrightness[i] = 0.0f;
+	}
+	for(uint remaining = lightMask; remaining != 0; remaining &= remaining - 1) {
+		int light = findLSB(remaining);
+		vec3 lightOnPoint = unshadowedPointLighting(light, hitPoint, eyePosition, normal, diffuse, specular, shininess);
+		unshadowedLighting += lightOnPoint;
+
+		//Keeps the list sorted, brightest first, by sliding dimmer ones down to make room
+		float brightness = dot(lightOnPoint, vec3(0.2126f, 0.7152f, 0.0722f));
+		for(int i = 0; i < pointLightShadowBudget; i++) {
+			if(brightness > shadowedBrightness[i]) {
+				int displacedLight = shadowedLights[i];
+				float displacedBrightness = shadowedBrightness[i];
+				shadowedLights[i] = light;
+				shadowedBrightness[i] = brightness;
+				light = displacedLight;
+				brightness = displacedBrightness;
+			}
+		}
+	}
+
+	uint shadowedMask = 0u;
+	for(int i = 0; i < pointLightShadowBudget && shadowedLights[i] >= 0; i++) {
+		shadowedMask |= 1u << shadowedLights[i];
+	}
+	return shadowedMask;
+}
+
+//Takes the light of every light in blockedMask, the ones whose shadow rays turned out to be blocked, back out of lighting.
+vec3 removeBlockedPointLights(vec3 lighting, uint blockedMask, vec3 hitPoint, vec3 eyePosition, vec3 normal, vec3 diffuse, vec3 specular, float shininess) {
+	for(uint remaining = blockedMask; remaining != 0; remaining &= remaining - 1) {
+		lighting -= unshadowedPointLighting(findLSB(remaining), hitPoint, eyePosition, normal, diffuse, specular, shininess);
+	}
+	return max(lighting, vec3(0, 0, 0));
+}
+
+//The light from every point light in pixel's froxel, with the chosen shadow rays marched right here.
+//shadowRays is how many shadow rays it marched.
+vec3 pointLighting(ivec2 pixel, float depth, vec3 hitPoint, vec3 eyePosition, vec3 normal, vec3 diffuse, vec3 specular, float shininess, out uint shadowRays) {
+	vec3 lighting;
+	uint shadowedMask = choosePointLightShadowRays(pixel, depth, hitPoint, eyePosition, normal, diffuse, specular, shininess, lighting);
+	shadowRays = bitCount(shadowedMask);
+	uint blockedMask = 0u;
+	for(uint remaining = shadowedMask; remaining != 0; remaining &= remaining - 1) {
+		int light = findLSB(remaining);
+		if(!pointLightReaches(light, hitPoint)) {
+			blockedMask |= 1u << light;
+		}
+	}
+	return removeBlockedPointLights(lighting, blockedMask, hitPoint, eyePosition, normal, diffuse, specular, shininess);
+}
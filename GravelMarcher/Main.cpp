@@ -4,7 +4,9 @@
 
 #include <string.h>
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 
 #include <vector>
 
@@ -14,6 +16,21 @@ using namespace std;
 #include <chrono>
 using namespace std::chrono;
 
+#include <string>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
 // Include GLEW
 #include <GL/glew.h>
 
@@ -21,6 +38,14 @@ using namespace std::chrono;
 #include <GLFW/glfw3.h>
 GLFWwindow* window;
 
+#include "Denoiser.h"
+#include "SdfBake.h"
+#include "SdfKernels.h"
+#include "RuntimeStats.h"
+#include "AnimationTracks.h"
+#include "AudioPlayer.h"
+#include "AudioSpectrum.h"
+
 // Include GLM
 #include <glm.hpp>
 using namespace glm;
@@ -29,74 +54,6 @@ using namespace glm;
 #include <gtx/string_cast.hpp>
 #include <gtx/quaternion.hpp>
 
-//-------------------------------------Animation stuff------------------------------
-
-#define INTERP_MODE_JUMP 0
-#define INTERP_MODE_LINEAR 1
-#define INTERP_MODE_COS 2
-
-template<typename T>
-struct AnimKeyFrame {
-	T value;
-	float frameTime;
-	int interpolationMode;
-
-	AnimKeyFrame() {
-		value, frameTime, interpolationMode = 0;
-	}
-	
-	AnimKeyFrame(T value_, float time_) {
-		value = value_;
-		frameTime = time_;
-		interpolationMode = INTERP_MODE_JUMP;
-	}
-
-	AnimKeyFrame(T value_, float time_, int interpolationMode_) {
-		value = value_;
-		frameTime = time_;
-		interpolationMode = interpolationMode_;
-	}
-};
-
-template<typename T>
-T animate(AnimKeyFrame<T> keyFrames[], int keyFrameCount, float t) {
-	if (keyFrameCount == 0) throw new exception("Can't animate something with 0 keyframes!");
-
-	//If t is before the animation start time, just return the first value
-	if (t <= keyFrames[0].frameTime) return keyFrames[0].value;
-
-	//If t is after the animation end time, just return the last value
-	if (t >= keyFrames[keyFrameCount - 1].frameTime) return keyFrames[keyFrameCount - 1].value;
-	
-	//Finds the keyframes we care about
-
-	AnimKeyFrame<T> keyFrameBefore, keyFrameAfter = keyFrames[0];
-	for (int i = 0; i < keyFrameCount; i++) {
-		//If it's greater than t, we've gone too far. keyFrameBefore will be set by the last run, so just break.
-		//This will also neccessarily be the first keyFrame where the time is greater than t, so set keyFrameAfter to that.
-		if (keyFrames[i].frameTime > t) {
-			keyFrameAfter = keyFrames[i];
-			break;
-		}
-		keyFrameBefore = keyFrames[i];
-	}
-
-	//Before worrying about mixing, check if it's a jump.
-	//By the way, the interpolation mode of the keyframe BEFORE is the one that matters.
-	if (keyFrameBefore.interpolationMode == INTERP_MODE_JUMP) {
-		return keyFrameBefore.value;
-	}
-
-	//Find the t to be used for mixing. This depends on the interpolation mode.
-	float mixT = (t - keyFrameBefore.frameTime) / (keyFrameAfter.frameTime - keyFrameBefore.frameTime);
-	if (keyFrameBefore.interpolationMode == INTERP_MODE_COS) {
-		mixT = (-cos(pi<float>() * mixT) + 1.0f) / 2.0f;
-	}
-
-	//Do the actual mixing
-	return(mix(keyFrameBefore.value, keyFrameAfter.value, mixT));
-}
-
 //---------------------------Animation keyframe lists-------------------------------------------
 
 //Keyframe list for ball diffuse color
@@ -142,13 +99,153 @@ AnimKeyFrame<vec3> keyFramesCamVel[] = {
 };
 int keyFramesCamVelCount = 3;
 
+//How bright the point lights are, when they're on
+AnimKeyFrame<float> keyFramesPointLightIntensity[] = {
+	AnimKeyFrame<float>(2.0f, 0.0f, INTERP_MODE_LINEAR),
+	AnimKeyFrame<float>(4.0f, 84.0f, INTERP_MODE_JUMP)
+};
+int keyFramesPointLightIntensityCount = 2;
+
+//Turns the camera on top of wherever the mouse has it pointing
+AnimKeyFrame<quat> keyFramesCamOrientation[] = {
+	AnimKeyFrame<quat>(quat(1, 0, 0, 0), 0.0f, INTERP_MODE_JUMP)
+};
+int keyFramesCamOrientationCount = 1;
+
+//---------------------------------Frame parameters-------------------------------------
+
+//The most views multi-view rendering can march at once. Enough for a cubemap.
+#define MAX_VIEWS 6
+
+//The most point lights there can be, and the most of them that can get shadow rays at any one pixel. See Lights.glsl.
+#define MAX_POINT_LIGHTS 32
+#define MAX_POINT_LIGHT_SHADOW_BUDGET 4
+
+//Everything the marcher is given that changes from frame to frame.
+//This is laid out to match the std140 FrameParams block in FrameParams.glsl, so it gets copied to the GPU as is.
+//Every vec3 is followed by a 4 byte value, since std140 pads a vec3 out to 16 bytes anyway.
+struct FrameParams {
+	mat4 matCameraToWorld;
+
+	vec3 ballsDiffuse;
+	float ballsShininess;
+	vec3 ballsSpecular;
+	float floorShininess;
+
+	vec3 floorDiffuse;
+	float sunShininess;
+	vec3 floorSpecular;
+	float sunOverSat;
+
+	vec3 ambientLight;
+	int doLambertian;
+
+	vec3 sunDirection;
+	float padding0;
+	vec3 skyColor;
+	float padding1;
+	vec3 sunColor;
+	float padding2;
+
+	mat4 matWorldToPreviousCamera;
+	float screenTop;
+	float screenRight;
+	int checkerboardEnabled;
+	int checkerboardPhase;
+
+	mat4 matViewToCamera[MAX_VIEWS];
+	int viewCount;
+
+	int variableRateEnabled;
+	int variableRateFoveated;
+	int variableRateDebugView;
+
+	int tileCullEnabled;
+	int wavefrontEnabled;
+	ivec2 targetSize;
+
+	mat4 matWorldToView;
+	vec4 pointLightPositions[MAX_POINT_LIGHTS];
+	vec4 pointLightColors[MAX_POINT_LIGHTS];
+	int pointLightCount;
+	int pointLightShadowBudget;
+	int ssaoEnabled;
+	int padding7;
+
+	vec4 audioBands[AUDIO_SPECTRUM_BANDS / 4];
+};
+
+//The animated values that aren't copied into FrameParams as they are, but that the CPU works something else out from.
+struct TimelineValues {
+	float sunAngle;
+	float pointLightIntensity;
+	vec3 cameraVelocity;
+	quat cameraOrientation;
+};
+
+//The timeline's tracks. Those that go straight into FrameParams are written right into it, and the rest into a TimelineValues.
+AnimationRegistry frameParamsTracks;
+AnimationRegistry timelineTracks;
+
+//---------------------------------------Music-------------------------------------------
+//The music streams from musicPath, and is what timeSinceStart is measured on. See AudioPlayer.h.
+//Its spectrum, baked into musicSpectrumPath with --bake-spectrum, goes into FrameParams' audioBands through frameParamsTracks.
+const char * musicPath = "music.wav";
+const char * musicSpectrumPath = "music.bands";
+AudioSpectrum musicSpectrum;
+
 GLuint loadShaderProgram(const char * vertex_file_path, const char * fragment_file_path);
 template <typename T>
 GLuint bufferVertexData(T data[], unsigned int dataSize);
 GLuint compileShader(const char * shaderPath, GLenum shaderType);
+bool expandShaderIncludes(std::string & shaderCode);
 //GLuint createEmptyTexture(unsigned short texWidth, unsigned short texHeight);
 GLuint loadComputeShaderProgram(const char * computeFilePath);
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void findUniformHandles(GLuint shaderProgramID);
+mat4 findCameraRotation();
+void registerAnimationTracks();
+void registerMusicSpectrum();
+void updateCameraPosition(mat4 matCameraRotation, float timeSinceStart, float deltaTime);
+dvec3 findWorldOrigin(dvec3 position);
+FrameParams evaluateFrame(float timeSinceStart, mat4 matCameraRotation);
+void createFrameParamsBuffer();
+void uploadFrameParams(const FrameParams & frameParams);
+void fenceFrame();
+void startFramePreparer();
+void requestFrameParams(float timeSinceStart, float deltaTime, mat4 matCameraRotation);
+FrameParams waitForFrameParams();
+void stopFramePreparer();
+void startShaderReloader();
+void applyReloadedShaders();
+void stopShaderReloader();
+void drawScreenQuad(int instanceCount = 1);
+void createMarcherTargets(int targetWidth, int targetHeight, int layers = 1);
+bool selectViewMode(const char * mode);
+bool selectRenderTargetFormat(const char * selection);
+void createSkyLUT();
+void updateSkyLUT();
+void renderFrame();
+void createAccumulationTargets(int targetWidth, int targetHeight);
+int renderProgressiveFrame();
+float findTimelineLength();
+long long renderedFrameBytes();
+long long fileBytes(const std::string & path);
+int runCoordinator(int argc, char* argv[]);
+int runWorker(int argc, char* argv[]);
+int runBenchmark(int argc, char* argv[]);
+double timeBenchmarkFrame(GLuint timerQueryID);
+GLuint createOffscreenFramebuffer(int targetWidth, int targetHeight);
+void readFramePixels(int targetWidth, int targetHeight, std::vector<unsigned char> & pixels);
+void readDenoisedFramePixels(std::vector<unsigned char> & pixels);
+void readMultiViewPixels(std::vector<unsigned char> & pixels);
+void createMarchStatsReadback();
+bool startMarchStatsSample();
+void finishMarchStatsSample();
+void setCollectMarchStats(bool enabled);
+void marchWavefront();
+void occludeAmbientLight();
+int placePointLights(FrameParams & frameParams, dvec3 worldOrigin, float timeSinceStart, float intensity);
 
 //---------------------------------Mouse motion variables--------------------------------------
 
@@ -161,45 +258,574 @@ float cameraPitch = 0.0f;
 
 //--------------------------------Key motion variables---------------------------------------
 
-vec3 cameraPos = vec3(0, 0, 2);
+//Where the camera is in world space. It's integrated every frame for as long as the show runs, so it's kept in double.
+//The shader never sees it as is. See findWorldOrigin.
+dvec3 cameraPos = dvec3(0, 0, 2);
 float cameraSpeed = 17.0f/3.0f;
-bool wDown = false;
-bool aDown = false;
-bool sDown = false;
-bool dDown = false;
-bool shiftDown = false;
-bool spaceDown = false;
+//These are set by the key callback on the main thread but read by the frame preparer, hence atomic.
+std::atomic<bool> wDown(false);
+std::atomic<bool> aDown(false);
+std::atomic<bool> sDown(false);
+std::atomic<bool> dDown(false);
+std::atomic<bool> shiftDown(false);
+std::atomic<bool> spaceDown(false);
 
 const unsigned short width = 1920;
 const unsigned short height = 1200;
 
 const float verticalFieldOfView = 45.0f;
 
-//------------------------------------World Variables------------------------------------
+//If the screen is 1 unit away from the camera, these are the distances from its center to its top and right edges.
+const float screenTop = tan(radians(verticalFieldOfView / 2));
+const float screenRight = screenTop * ((float)width) / ((float)height);
+
+//---------------------------------Checkerboard rendering--------------------------------
+
+//When set, only half the pixels are marched each frame, in a checkerboard that flips every frame.
+//The other half are reprojected from the frame before. Toggled with C, or turned on from the start with --checkerboard.
+std::atomic<bool> checkerboardEnabled(false);
+
+//Counts frames, so the checkerboard knows which half to march.
+int checkerboardFrameIndex = 0;
+
+//Last frame's camera, for reprojecting into it. The position is in world space, since each frame has its own local origin.
+dvec3 previousCameraPos;
+mat4 previousMatCameraRotation;
+bool hasPreviousCamera = false;
+
+//---------------------------------Multi-view rendering---------------------------------
+//For the stereo and 360 versions of the show, every frame can be marched from several views at once.
+//Each view is one instance of the screen quad, drawn into its own layer of the render targets, so the frame is only evaluated and set up once.
+//Turned on with --views stereo or --views cubemap. Offline only, since the window has nowhere to show the extra layers.
+
+int viewCount = 1;
+
+//Where each view sits relative to the camera
+mat4 matViewToCamera[MAX_VIEWS] = { mat4(1.0f) };
+
+//The size and field of view of a single view
+int viewWidth = width;
+int viewHeight = height;
+float viewScreenTop = screenTop;
+float viewScreenRight = screenRight;
+
+//How far apart the eyes are in stereo, in world units. The balls are 2 units across.
+const float stereoEyeSeparation = 0.1f;
+
+//------------------------------Variable-rate marching----------------------------------
+//Tiles of the screen march at full rate, or only one pixel per 2x2 or 4x4 block, depending on how much detail they had last frame.
+//Open sky and the far floor end up costing a fraction of the sphere silhouettes. Toggled with V, or on from the start with --variable-rate.
+//--foveated also coarsens the edges of the screen. M toggles a debug view that tints each tile by its rate.
+//Like checkerboarding, it skips pixels, so the two can't be on at once.
+std::atomic<bool> variableRateEnabled(false);
+std::atomic<bool> variableRateDebugView(false);
+bool variableRateFoveated = false;
+
+//------------------------------------Tile culling---------------------------------------
+//Before marching, each 16x16 tile of the screen works out how far all its rays can go without hitting anything, using interval arithmetic
+//over the tile's cone of rays. The marcher starts that far out, and tiles that are all sky don't march at all.
+//On unless --no-tile-cull is given. T toggles it, to compare. Multi-view doesn't cull, since the tiles are worked out for one view.
+std::atomic<bool> tileCullEnabled(true);
+
+//---------------------------------Wavefront marching-------------------------------------
+//Instead of one fragment marching its camera ray then its shadow ray, a few persistent workgroups pull rays off queues in buffers,
+//and a lane whose ray stops takes the next one instead of waiting on its slowest neighbor. See WavefrontQueues.glsl.
+//Toggled with R, or on from the start with --wavefront. It marches every pixel, so it replaces checkerboarding and variable rate.
+std::atomic<bool> wavefrontEnabled(false);
+
+//------------------------------Ambient occlusion-----------------------------------------
+//The flat ambient light gets darkened where the marcher's depth and normal targets say something's close by, in screen space.
+//Ssao.glsl works it out at half resolution, and SsaoUpsample.glsl takes the occluded part back out of the color target.
+//On unless --no-ssao is given. O toggles it. Only for modes that march every pixel of one view, and progressive mode has its own.
+std::atomic<bool> ssaoEnabled(true);
+
+//---------------------------------Point lights-------------------------------------------
+//Lights that circle the balls near the camera, on top of the sun. LightCull.glsl sorts them into froxels each frame, so a pixel
+//only shades the ones that can reach it, and only the brightest few on each pixel get shadow rays. See Lights.glsl.
+//Toggled with L, or on from the start with --point-lights. --light-shadow-budget n sets how many get shadow rays. Not in multi-view.
+std::atomic<bool> pointLightsEnabled(false);
+int pointLightShadowBudget = 2;
+
+//How far a point light reaches. Has to match pointLightRadius in Lights.glsl.
+const float pointLightRadius = 4.0f;
+
+//Each ball has this many lights going around it, each at its own height, in alternating directions.
+const int pointLightsPerBall = 2;
+const float pointLightOrbitRadius = 1.5f;
+const float pointLightOrbitSpeed = 1.5f;
+const float pointLightHeights[pointLightsPerBall] = { 0.3f, -0.5f };
+
+//Lights fade out between these distances from the camera, so they don't pop in and out as it moves from cell to cell.
+//The lights come from the cells pointLightFirstCell to pointLightLastCell away from the origin cell along x and z.
+//That's every light that can be closer than pointLightFadeEnd, since the camera is always in the origin cell, toward its high corner.
+const float pointLightFadeStart = 4.0f;
+const float pointLightFadeEnd = 6.0f;
+const int pointLightFirstCell = -1;
+const int pointLightLastCell = 2;
+
+//Each ball's lights are one of these colors, picked by which cell it's in.
+const vec3 pointLightPalette[] = { vec3(1.0f, 0.6f, 0.2f), vec3(0.2f, 0.8f, 1.0f), vec3(1.0f, 0.3f, 0.8f), vec3(0.4f, 1.0f, 0.3f) };
+const int pointLightPaletteSize = sizeof(pointLightPalette) / sizeof(pointLightPalette[0]);
+
+//How much brighter the lowest band of the music makes the lights, at its loudest
+const float pointLightBassPulse = 1.0f;
 
-//How long, in seconds, the 'day' is (the period the sun takes to revolve a full 360 degrees)
-const float dayLength = 120;
+//------------------------------------World Variables------------------------------------
 
 //The maximum angular elevation, in degrees, the sun achieves in a day.
 const float sunMaxElevation = 50;
 
-//The color of the sky at night
-const vec3 skyColorNight = vec3(0, 0.05, 0.1);
+//How often the scene repeats along x and z. Has to match deformation() in Scene.glsl.
+const double sceneRepetitionPeriod = 4.0;
+
+//How far camera rays go before they're counted as sky. Has to match camRayTooFar in Scene.glsl.
+const float camRayTooFar = 1000.0f;
+
+//The axis the sun revolves around over the course of a day.
+const vec3 sunRevolutionAxis = vec3(0, sinf(radians(90 - sunMaxElevation)), cosf(radians(90 - sunMaxElevation)));
+
+//------------------------------------Uniform handles------------------------------------
+
+GLuint progressiveEnabledID;
+GLuint progressiveSampleIndexID;
+GLuint progressiveMinSamplesID;
+GLuint progressiveVarianceThresholdID;
+
+//-------------------------------------Screen quad buffers-------------------------------
+
+GLuint verticesBufferID;
+GLuint uvsBufferID;
+GLuint indicesBufferID;
+
+//The buffer MarchStats.glsl's counts are summed into when collectMarchStats is set.
+//It also holds how many pixels are still taking samples in progressive mode.
+GLuint marchStatsBufferID;
+#define MARCH_STATS_STEPS_TOTAL 0
+#define MARCH_STATS_STEPS_MAX 1
+#define MARCH_STATS_MAX_ITERS_PIXELS 2
+#define MARCH_STATS_PROGRESSIVE_ACTIVE_PIXELS 3
+#define MARCH_STATS_MARCHED_PIXELS 4
+#define MARCH_STATS_SHADOW_RAYS 5
+#define MARCH_STATS_COUNT 6
+
+//---------------------------------Runtime statistics-------------------------------------
+//With --stats-socket <path>, the interactive show serves live stats on a Unix domain socket. See RuntimeStats.h.
+//The march statistics have to come from the GPU, so every marchStatsSampleInterval frames, one frame is marched with them on
+//and they're copied into a mapped buffer. A later frame picks them up once it finds the copy's fence has passed, so nothing waits on it.
+
+const char * statsSocketPath = NULL;
+
+//The atomics make the sampled frame a little slower, so it's not done every frame.
+const int marchStatsSampleInterval = 60;
+int framesSinceMarchStatsSample = 0;
+
+GLuint marchStatsReadbackBufferID;
+GLuint * marchStatsReadbackMapping;
+GLsync marchStatsReadbackFence = 0;
+
+//-------------------------------Progressive accumulation--------------------------------
+//For final quality offline frames. Each frame is drawn over and over with soft shadows, sky light and ambient occlusion sampled at random,
+//and the samples are averaged. Pixels stop sampling once they've converged, so the samples go where the noise is.
+
+//Turned on with --progressive [maxSamples].
+bool progressiveEnabled = false;
+
+//The most samples any frame gets, however noisy it still is.
+int progressiveMaxSamples = 256;
+
+//Every pixel takes at least this many, so its variance estimate is worth something.
+const int progressiveMinSamples = 16;
+
+//A pixel is converged once the standard error of its mean luminance is under this fraction of the mean. Can be set with --variance-threshold.
+float progressiveVarianceThreshold = 0.01f;
+
+//Checking whether every pixel has converged means waiting on the GPU, so it's only done every this many samples.
+const int progressiveCheckInterval = 8;
+
+//The running sums the marcher accumulates samples into.
+GLuint accumulationTextureID;
+GLuint accumulationLumaSquaresTextureID;
+
+//When set with --denoise, offline frames are run through the CPU denoiser before they're written out.
+//Meant for progressive frames with a small sample budget.
+bool denoiseEnabled = false;
+
+//---------------------------------Frame pipelining--------------------------------------
+//The CPU gets a few frames ahead of the GPU instead of the two waiting on each other every frame.
+//Each frame in flight gets its own slot of FrameParams in one persistently mapped buffer, and a fence saying when the GPU is done with it.
+
+//How many frames the CPU can get ahead of the GPU. Can be set with --frames-in-flight, up to framesInFlightLimit.
+int maxFramesInFlight = 2;
+const int framesInFlightLimit = 4;
+
+GLuint frameParamsBufferID;
+unsigned char * frameParamsMapping;
+GLint frameParamsSlotSize;
+GLsync frameParamsFences[framesInFlightLimit];
+int frameParamsSlot = 0;
+
+//The frame preparer is a thread that animates and moves the camera for the next frame while the GPU marches the current one.
+//The main thread hands it a request, goes off to do GL work, then picks up the result.
+std::thread framePreparerThread;
+std::mutex framePreparerMutex;
+std::condition_variable framePreparerCondition;
+bool framePreparerHasRequest = false;
+bool framePreparerHasResult = false;
+bool framePreparerQuitting = false;
+float framePreparerTime;
+float framePreparerDeltaTime;
+mat4 framePreparerCameraRotation;
+FrameParams framePreparerResult;
 
-//The color of the sky at day
-const vec3 skyColorDay = vec3(0.7, 0.8, 1);
+//-----------------------------------Shader programs--------------------------------------
+
+//Marches the scene into the render targets
+GLuint marcherProgramID;
+
+//Copies the color target onto whatever framebuffer the frame ends up in
+GLuint presentProgramID;
+
+//Fills in the pixels the marcher skipped in checkerboard mode
+GLuint checkerboardResolveProgramID;
+
+//Fills in the sky LUT
+GLuint skyLUTProgramID;
+
+//Spreads each block's marched pixel over the block in variable-rate mode
+GLuint variableRateResolveProgramID;
+
+//Works out next frame's rate map in variable-rate mode
+GLuint variableRateMapProgramID;
+
+//The marcher again, but drawn as one small quad per tile in variable-rate mode
+GLuint variableRateMarcherProgramID;
+
+//Works out how far each tile's rays can skip before marching
+GLuint tileCullProgramID;
+
+//The wavefront stages: camera rays, shadow rays, then lighting.
+GLuint wavefrontPrimaryProgramID;
+GLuint wavefrontShadowProgramID;
+GLuint wavefrontShadeProgramID;
 
-//A constant that determines how quickly the sky color changes between its night and day color.
-//A higher value will mean faster, a lower value will mean slower.
-const float skyColorLogB = 5.0f;
+//Sorts the point lights into froxels.
+GLuint lightCullProgramID;
 
-int main(void)
+//Works out the ambient occlusion at half resolution, then takes it out of the color target at full.
+GLuint ssaoProgramID;
+GLuint ssaoUpsampleProgramID;
+
+//--------------------------------Shader hot reloading-------------------------------------
+//While the show is running, shader files are watched and any program using a changed one is rebuilt on a background context.
+//The rebuilt program is swapped in between frames, and only once the GPU has it ready, so there's no hitch.
+//If it doesn't compile, the old one just keeps going.
+
+//A program that gets rebuilt whenever one of its source files changes.
+//Either both vertexPath and fragmentPath are set, or just computePath is.
+struct ReloadableProgram {
+	const char * vertexPath;
+	const char * fragmentPath;
+	const char * computePath;
+	GLuint * programID;
+
+	//A rebuilt program waiting to be swapped in, and the fence saying the GPU is done building it. Guarded by shaderReloaderMutex.
+	GLuint pendingProgramID;
+	GLsync pendingFence;
+};
+
+ReloadableProgram reloadablePrograms[] = {
+	{ "VertexMarcher.glsl", "FragmentMarcher.glsl", NULL, &marcherProgramID, 0, 0 },
+	{ "QuadVertex.glsl", "QuadFragment.glsl", NULL, &presentProgramID, 0, 0 },
+	{ "VertexMarcher.glsl", "CheckerboardResolve.glsl", NULL, &checkerboardResolveProgramID, 0, 0 },
+	{ NULL, NULL, "SkyLUT.glsl", &skyLUTProgramID, 0, 0 },
+	{ "VertexMarcher.glsl", "VariableRateResolve.glsl", NULL, &variableRateResolveProgramID, 0, 0 },
+	{ NULL, NULL, "VariableRateMap.glsl", &variableRateMapProgramID, 0, 0 },
+	{ "VariableRateTiles.glsl", "FragmentMarcher.glsl", NULL, &variableRateMarcherProgramID, 0, 0 },
+	{ NULL, NULL, "TileCull.glsl", &tileCullProgramID, 0, 0 },
+	{ NULL, NULL, "WavefrontPrimary.glsl", &wavefrontPrimaryProgramID, 0, 0 },
+	{ NULL, NULL, "WavefrontShadow.glsl", &wavefrontShadowProgramID, 0, 0 },
+	{ "VertexMarcher.glsl", "WavefrontShade.glsl", NULL, &wavefrontShadeProgramID, 0, 0 },
+	{ NULL, NULL, "LightCull.glsl", &lightCullProgramID, 0, 0 },
+	{ NULL, NULL, "Ssao.glsl", &ssaoProgramID, 0, 0 },
+	{ "VertexMarcher.glsl", "SsaoUpsample.glsl", NULL, &ssaoUpsampleProgramID, 0, 0 }
+};
+const int reloadableProgramCount = sizeof(reloadablePrograms) / sizeof(reloadablePrograms[0]);
+
+//Files that are only ever pulled in with #include. Since they could be in any program, changing one rebuilds everything.
+const char * sharedShaderFiles[] = { "FrameParams.glsl", "SkyLUTMapping.glsl", "VariableRate.glsl", "Scene.glsl", "TileCulling.glsl", "Shading.glsl",
+	"WavefrontQueues.glsl", "WavefrontMarch.glsl", "Lights.glsl", "MarchStats.glsl", "Checkerboard.glsl" };
+const int sharedShaderFileCount = sizeof(sharedShaderFiles) / sizeof(sharedShaderFiles[0]);
+
+//A hidden window whose context shares objects with the main one. The reloader compiles in it.
+GLFWwindow * shaderReloaderWindow;
+std::thread shaderReloaderThread;
+std::mutex shaderReloaderMutex;
+std::atomic<bool> shaderReloaderQuitting(false);
+
+//How often, in milliseconds, the reloader checks for changed files or whether it should quit.
+const int shaderReloaderPollInterval = 250;
+
+//------------------------------------Render targets---------------------------------------
+//The marcher draws into these rather than straight to the screen, so later passes can read what it found.
+//Each target gets its own format, picked to be no bigger than what it actually holds.
+
+#define RENDER_TARGET_COLOR 0
+#define RENDER_TARGET_DEPTH 1
+#define RENDER_TARGET_SHADOW 2
+#define RENDER_TARGET_STEPS 3
+#define RENDER_TARGET_NORMAL 4
+#define RENDER_TARGET_AMBIENT 5
+#define RENDER_TARGET_COUNT 6
+
+//A texture format a render target can be stored in.
+struct RenderTargetFormat {
+	const char * name;
+	GLenum internalFormat;
+	bool isInteger;
+};
+
+//Every format a render target can be switched to with --target-format.
+const RenderTargetFormat renderTargetFormatChoices[] = {
+	{ "r11f_g11f_b10f", GL_R11F_G11F_B10F, false },
+	{ "rgba16f", GL_RGBA16F, false },
+	{ "rgba32f", GL_RGBA32F, false },
+	{ "rg16f", GL_RG16F, false },
+	{ "r8", GL_R8, false },
+	{ "r16f", GL_R16F, false },
+	{ "r32f", GL_R32F, false },
+	{ "r16ui", GL_R16UI, true },
+	{ "r32ui", GL_R32UI, true }
+};
+const int renderTargetFormatChoiceCount = sizeof(renderTargetFormatChoices) / sizeof(renderTargetFormatChoices[0]);
+
+//The names the targets go by on the command line, in RENDER_TARGET order.
+const char * renderTargetNames[RENDER_TARGET_COUNT] = { "color", "depth", "shadow", "steps", "normal", "ambient" };
+
+//The format each target is actually made with.
+//Color is LDR and ends up on an 8 bit swapchain anyway, so 32 bits per pixel is plenty.
+//Depth is the distance the camera ray went, up to camRayTooFar, which 16 bit floats would make very blocky far away.
+//Shadow is just lit or not. Steps never goes past camRayMaxSteps, which fits in 16 bits.
+//Normals are octahedral encoded into two components, which 16 bit floats hold plenty well.
+//Ambient is part of the color, so it's stored like it.
+RenderTargetFormat renderTargetFormats[RENDER_TARGET_COUNT] = {
+	renderTargetFormatChoices[0],
+	renderTargetFormatChoices[6],
+	renderTargetFormatChoices[4],
+	renderTargetFormatChoices[7],
+	renderTargetFormatChoices[3],
+	renderTargetFormatChoices[0]
+};
+
+GLuint renderTargetTextureIDs[RENDER_TARGET_COUNT];
+GLuint marcherFramebufferID;
+
+//Checkerboard mode resolves into one of these each frame, reading the other as last frame's image.
+GLuint checkerboardHistoryTextureIDs[2];
+GLuint checkerboardHistoryFramebufferIDs[2];
+int checkerboardHistoryIndex = 0;
+
+//Variable-rate mode's rate map, one texel per tile, and the texture it resolves into.
+//Must match VARIABLE_RATE_TILE_SIZE in VariableRate.glsl.
+const int variableRateTileSize = 16;
+GLuint variableRateMapTextureID;
+int variableRateMapWidth;
+int variableRateMapHeight;
+GLuint variableRateResolvedTextureID;
+GLuint variableRateResolvedFramebufferID;
+
+//How far each tile's rays can skip, one texel per tile. Written by TileCull.glsl as an image, read by the marcher as a texture.
+//Must match TILE_CULL_SIZE in TileCulling.glsl.
+const int tileCullSize = 16;
+GLuint tileStartDistancesTextureID;
+int tileCullWidth;
+int tileCullHeight;
+
+//Wavefront mode's queues and the buffers the stages hand their results over in, sized for every pixel.
+//Must match WavefrontQueues.glsl.
+#define WAVEFRONT_QUEUE_PRIMARY 0
+#define WAVEFRONT_QUEUE_SHADOW 1
+const int wavefrontPixelBlockSize = 8;
+struct WavefrontQueueHeader {
+	GLuint queueLength[2];
+	GLuint queueClaimed[2];
+	GLuint targetWidth;
+	GLuint targetHeight;
+};
+GLuint wavefrontQueuesBufferID;
+GLuint wavefrontHitsBufferID;
+GLuint wavefrontShadowRaysBufferID;
+GLuint wavefrontSunVisibilitiesBufferID;
+GLuint wavefrontBlockedPointLightsBufferID;
+
+//One light mask per froxel, after a header holding how many froxels across and down the screen is. Must match Lights.glsl.
+#define LIGHT_CLUSTER_TILE_SIZE 32
+#define LIGHT_CLUSTER_SLICES 24
+GLuint lightClustersBufferID;
+GLuint lightClusterTilesWide;
+GLuint lightClusterTilesHigh;
+
+//The half resolution ambient occlusion, with the depth each texel was worked out at. Written by Ssao.glsl as an image.
+//The upsample draws into a framebuffer of just the color target, with blending doing the subtracting.
+GLuint ssaoTextureID;
+int ssaoWidth;
+int ssaoHeight;
+GLuint ssaoFramebufferID;
+
+//How many workgroups each wavefront stage is dispatched as. They loop until their queue runs dry, so this only needs to fill the GPU.
+const int wavefrontPersistentGroupCount = 1024;
+
+//Whether variable-rate mode was on last frame. When it comes back on, the rate map is stale, so it starts again from full rate.
+bool variableRateWasEnabled = false;
+
+int marcherTargetWidth;
+int marcherTargetHeight;
+
+//The framebuffer the finished frame is presented into. 0 is the window.
+GLuint outputFramebufferID = 0;
+
+//The params last handed to uploadFrameParams. The passes after the marcher look here to see what the frame asked for.
+FrameParams currentFrameParams;
+
+//The sky as seen from every direction, laid out as in SkyLUTMapping.glsl.
+//The sun's highlight is tight, so most of the width goes to the angle from the sun.
+const int skyLUTWidth = 256;
+const int skyLUTHeight = 64;
+GLuint skyLUTTextureID;
+
+//The params the sky LUT was last filled from, so it's only refilled when the sky actually changes.
+FrameParams skyLUTFrameParams;
+bool skyLUTIsValid = false;
+
+//-----------------------------------Offline rendering------------------------------------
+
+//The rate the timeline is sampled at when rendering offline.
+//Time comes from the frame number rather than the clock, so any frame can be rendered by any process and come out the same.
+float renderFramesPerSecond = 60.0f;
+
+//How many frames the coordinator hands to a worker at once.
+int renderRangeFrames = 120;
+
+//How many times the coordinator will try a frame range before giving up on the whole render.
+const int renderRangeMaxAttempts = 3;
+
+//A contiguous run of frames given to one worker process.
+struct FrameRange {
+	int firstFrame;
+	int frameCount;
+	int attempts;
+};
+
+//------------------------------------Benchmarking---------------------------------------
+
+//The benchmark renders at a fixed, small size so it stays quick even on a software GL driver.
+const int benchmarkWidth = 480;
+const int benchmarkHeight = 300;
+
+//Each shot is timed this many times, and the median is what counts.
+const int benchmarkRepeats = 5;
+
+//How far a shot can fall from its golden image or baseline before the benchmark fails.
+const double benchmarkMinPSNR = 40.0;
+const double benchmarkMinSSIM = 0.98;
+const double benchmarkMaxFrameTimeRegression = 0.15;
+const double benchmarkMaxStepsRegression = 0.05;
+
+//Where the golden images and baseline numbers live, relative to the EXE.
+const char * benchmarkGoldenPrefix = "benchmark_golden_";
+const char * benchmarkBaselinePath = "benchmark_baseline.txt";
+
+//A moment on the timeline the benchmark renders. These must stay in time order, since the camera is integrated from one to the next.
+struct BenchmarkShot {
+	const char * name;
+	float time;
+};
+
+const BenchmarkShot benchmarkShots[] = {
+	{ "night_start", 5.0f },
+	{ "sun_rising", 30.0f },
+	{ "camera_turn", 39.5f },
+	{ "before_lambertian", 54.5f },
+	{ "after_lambertian", 55.5f },
+	{ "second_sun_sweep", 70.0f },
+	{ "final_color", 122.0f }
+};
+const int benchmarkShotCount = sizeof(benchmarkShots) / sizeof(benchmarkShots[0]);
+
+int main(int argc, char* argv[])
 {
+	registerAnimationTracks();
+
+	//Offline rendering options can come anywhere on the command line.
+	for (int i = 1; i < argc - 1; i++) {
+		if (strcmp(argv[i], "--fps") == 0) renderFramesPerSecond = (float)atof(argv[i + 1]);
+		if (strcmp(argv[i], "--range-frames") == 0) renderRangeFrames = atoi(argv[i + 1]);
+		if (strcmp(argv[i], "--frames-in-flight") == 0) maxFramesInFlight = clamp(atoi(argv[i + 1]), 1, framesInFlightLimit);
+		if (strcmp(argv[i], "--variance-threshold") == 0) progressiveVarianceThreshold = (float)atof(argv[i + 1]);
+		if (strcmp(argv[i], "--target-format") == 0 && !selectRenderTargetFormat(argv[i + 1])) return -1;
+		if (strcmp(argv[i], "--views") == 0 && !selectViewMode(argv[i + 1])) return -1;
+		if (strcmp(argv[i], "--stats-socket") == 0) statsSocketPath = argv[i + 1];
+		if (strcmp(argv[i], "--light-shadow-budget") == 0) pointLightShadowBudget = clamp(atoi(argv[i + 1]), 0, MAX_POINT_LIGHT_SHADOW_BUDGET);
+	}
+
+	//Asks Mesa for its software rasterizer, so the benchmark can run on boxes without a real GPU.
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--checkerboard") == 0) checkerboardEnabled = true;
+		if (strcmp(argv[i], "--variable-rate") == 0) variableRateEnabled = true;
+		if (strcmp(argv[i], "--no-tile-cull") == 0) tileCullEnabled = false;
+		if (strcmp(argv[i], "--no-ssao") == 0) ssaoEnabled = false;
+		if (strcmp(argv[i], "--wavefront") == 0) wavefrontEnabled = true;
+		if (strcmp(argv[i], "--point-lights") == 0) pointLightsEnabled = true;
+		if (strcmp(argv[i], "--foveated") == 0) variableRateEnabled = variableRateFoveated = true;
+		if (strcmp(argv[i], "--denoise") == 0) denoiseEnabled = true;
+		if (strcmp(argv[i], "--progressive") == 0) {
+			progressiveEnabled = true;
+			if (i + 1 < argc && isdigit(argv[i + 1][0])) progressiveMaxSamples = std::max(atoi(argv[i + 1]), 1);
+		}
+		if (strcmp(argv[i], "--software-gl") == 0) {
+#ifdef _WIN32
+			_putenv_s("LIBGL_ALWAYS_SOFTWARE", "1");
+			_putenv_s("GALLIUM_DRIVER", "llvmpipe");
+#else
+			setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+			setenv("GALLIUM_DRIVER", "llvmpipe", 1);
+#endif
+		}
+	}
+
+	//Multi-view marches straight into layers, which nothing that works on one flat image understands
+	bool isRendering = argc >= 2 && (strcmp(argv[1], "--coordinator") == 0 || strcmp(argv[1], "--worker") == 0);
+	if (viewCount > 1 && (!isRendering || progressiveEnabled || checkerboardEnabled || variableRateEnabled || denoiseEnabled || wavefrontEnabled)) {
+		fprintf(stderr, "--views only works with --coordinator or --worker, and not with --progressive, --checkerboard, --variable-rate, --denoise or --wavefront\n");
+		return -1;
+	}
+
+	//The coordinator never touches OpenGL. It just splits the timeline up and hands it to worker processes.
+	if (argc >= 2 && strcmp(argv[1], "--coordinator") == 0) {
+		return runCoordinator(argc, argv);
+	}
+
+	//Neither does baking, which evaluates the scene on the CPU
+	if (argc >= 2 && strcmp(argv[1], "--bake-sdf") == 0) {
+		return runSdfBake(argc, argv);
+	}
+	if (argc >= 2 && strcmp(argv[1], "--bake-spectrum") == 0) {
+		return runSpectrumBake(argc, argv);
+	}
+
+	//Only mapped once it's clear this run isn't the one baking it
+	registerMusicSpectrum();
+
+	bool isWorker = argc >= 2 && strcmp(argv[1], "--worker") == 0;
+	bool isBenchmark = argc >= 2 && strcmp(argv[1], "--benchmark") == 0;
+
+	//Nobody is watching the offline modes, so they shouldn't show a window or wait on a keypress
+	bool isOffline = isWorker || isBenchmark;
+
 	// Initialise GLFW
 	if (!glfwInit())
 	{
 		fprintf(stderr, "Failed to initialize GLFW\n");
-		getchar();
+		if (!isOffline) getchar();
 		return -1;
 	}
 
@@ -209,11 +835,16 @@ int main(void)
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+	//The offline modes render offscreen, so their window never needs to be seen
+	if (isOffline) {
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	}
+
 	// Open a window and create its OpenGL context
 	window = glfwCreateWindow(width, height, "GravelMarcher", NULL, NULL);
 	if (window == NULL) {
 		fprintf(stderr, "Failed to open GLFW window. If you have an Intel GPU, they are not 3.3 compatible. Try the 2.1 version of the tutorials.\n");
-		getchar();
+		if (!isOffline) getchar();
 		glfwTerminate();
 		return -1;
 	}
@@ -222,7 +853,14 @@ int main(void)
 	// Initialize GLEW
 	if (glewInit() != GLEW_OK) {
 		fprintf(stderr, "Failed to initialize GLEW\n");
-		getchar();
+		if (!isOffline) getchar();
+		glfwTerminate();
+		return -1;
+	}
+
+	//Without this, every instance of the quad would land on the first layer
+	if (viewCount > 1 && !GLEW_ARB_shader_viewport_layer_array) {
+		fprintf(stderr, "--views needs GL_ARB_shader_viewport_layer_array, which this driver doesn't have\n");
 		glfwTerminate();
 		return -1;
 	}
@@ -243,8 +881,30 @@ int main(void)
 	glGenVertexArrays(1, &vertexArrayID);
 	glBindVertexArray(vertexArrayID);
 
-	//Sets up the shader program
-	GLuint shaderProgramID = loadShaderProgram("VertexMarcher.glsl", "FragmentMarcher.glsl");
+	//Sets up the shader programs
+	marcherProgramID = loadShaderProgram("VertexMarcher.glsl", "FragmentMarcher.glsl");
+	presentProgramID = loadShaderProgram("QuadVertex.glsl", "QuadFragment.glsl");
+	checkerboardResolveProgramID = loadShaderProgram("VertexMarcher.glsl", "CheckerboardResolve.glsl");
+	skyLUTProgramID = loadComputeShaderProgram("SkyLUT.glsl");
+	variableRateResolveProgramID = loadShaderProgram("VertexMarcher.glsl", "VariableRateResolve.glsl");
+	variableRateMapProgramID = loadComputeShaderProgram("VariableRateMap.glsl");
+	tileCullProgramID = loadComputeShaderProgram("TileCull.glsl");
+	variableRateMarcherProgramID = loadShaderProgram("VariableRateTiles.glsl", "FragmentMarcher.glsl");
+	wavefrontPrimaryProgramID = loadComputeShaderProgram("WavefrontPrimary.glsl");
+	wavefrontShadowProgramID = loadComputeShaderProgram("WavefrontShadow.glsl");
+	wavefrontShadeProgramID = loadShaderProgram("VertexMarcher.glsl", "WavefrontShade.glsl");
+	lightCullProgramID = loadComputeShaderProgram("LightCull.glsl");
+	ssaoProgramID = loadComputeShaderProgram("Ssao.glsl");
+	ssaoUpsampleProgramID = loadShaderProgram("VertexMarcher.glsl", "SsaoUpsample.glsl");
+	if (marcherProgramID == 0 || presentProgramID == 0 || checkerboardResolveProgramID == 0 || skyLUTProgramID == 0 ||
+		variableRateResolveProgramID == 0 || variableRateMapProgramID == 0 || variableRateMarcherProgramID == 0 || tileCullProgramID == 0 ||
+		wavefrontPrimaryProgramID == 0 || wavefrontShadowProgramID == 0 || wavefrontShadeProgramID == 0 || lightCullProgramID == 0 ||
+		ssaoProgramID == 0 || ssaoUpsampleProgramID == 0) {
+		fprintf(stderr, "Failed to build the shader programs\n");
+		if (!isOffline) getchar();
+		glfwTerminate();
+		return -1;
+	}
 
 	//The screen-space coordinates that make up the quad
 	float quadVertices[] = {
@@ -253,7 +913,7 @@ int main(void)
 		-1.0f, 1.0f, 0.0f,
 		1.0f, 1.0f, 0.0f,
 	};
-	GLuint verticesBufferID = bufferVertexData(quadVertices, sizeof(quadVertices));
+	verticesBufferID = bufferVertexData(quadVertices, sizeof(quadVertices));
 
 	//The UVs of the quad
 	float quadUVs[] = {
@@ -262,181 +922,111 @@ int main(void)
 		0, 1,
 		1, 1
 	};
-	GLuint uvsBufferID = bufferVertexData(quadUVs, sizeof(quadUVs));
-
-	//The ray directions of the quad
-	float screenTop = tan(radians(verticalFieldOfView / 2));
-	float aspectRatio = ((float)width) / ((float)height);
-	float screenRight = screenTop * aspectRatio;
-	float quadRayDirections[] = {
-		-screenRight, -screenTop, -1,
-		screenRight, -screenTop, -1,
-		-screenRight, screenTop, -1,
-		screenRight, screenTop, -1,
-	};
-	GLuint rayDirectionBufferID = bufferVertexData(quadRayDirections, sizeof(quadRayDirections));
+	uvsBufferID = bufferVertexData(quadUVs, sizeof(quadUVs));
 
 	//The triangles that make up the quad
 	unsigned short quadIndices[] = {
 		0, 3, 1,
 		0, 3, 2
 	};
-	GLuint indicesBufferID;
 	glGenBuffers(1, &indicesBufferID);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indicesBufferID);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quadIndices), quadIndices, GL_STATIC_DRAW);	
 
-	//------------------------Uniform handles-------------------------
+	//Sets up the march statistics buffer. Only the progressive pixel count is touched unless collectMarchStats is set.
+	glGenBuffers(1, &marchStatsBufferID);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, marchStatsBufferID);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, MARCH_STATS_COUNT * sizeof(GLuint), NULL, GL_DYNAMIC_READ);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, marchStatsBufferID);
+
+	findUniformHandles(marcherProgramID);
+	glUseProgram(marcherProgramID);
+	createFrameParamsBuffer();
+	createSkyLUT();
 
-	GLuint ballsDiffuseID = glGetUniformLocation(shaderProgramID, "ballsDiffuse");
-	GLuint ballsSpecularID = glGetUniformLocation(shaderProgramID, "ballsSpecular");
-	GLuint ballsShininessID = glGetUniformLocation(shaderProgramID, "ballsShininess");
+	//The benchmark marches at its own, smaller size. Everything else marches at the window size.
+	if (isBenchmark) {
+		createMarcherTargets(benchmarkWidth, benchmarkHeight);
+	}
+	else {
+		createMarcherTargets(viewWidth, viewHeight, viewCount);
+	}
 
-	GLuint floorDiffuseID = glGetUniformLocation(shaderProgramID, "floorDiffuse");
-	GLuint floorSpecularID = glGetUniformLocation(shaderProgramID, "floorSpecular");
-	GLuint floorShininessID = glGetUniformLocation(shaderProgramID, "floorShininess");
+	//Both skip pixels. Checkerboarding wins if both were asked for.
+	if (checkerboardEnabled) {
+		variableRateEnabled = false;
+	}
 
-	GLuint ambientLightID = glGetUniformLocation(shaderProgramID, "ambientLight");
-	GLuint doLambertianID = glGetUniformLocation(shaderProgramID, "doLambertian");
-	
-	GLuint sunDirectionID = glGetUniformLocation(shaderProgramID, "sunDirection");
-	GLuint skyColorID = glGetUniformLocation(shaderProgramID, "skyColor");
-	GLuint sunColorID = glGetUniformLocation(shaderProgramID, "sunColor");
-	GLuint sunShininess = glGetUniformLocation(shaderProgramID, "sunShininess");
-	GLuint sunOverSat = glGetUniformLocation(shaderProgramID, "sunOverSat");
+	//Wavefront mode marches every pixel, so it wins over both
+	if (wavefrontEnabled) {
+		checkerboardEnabled = false;
+		variableRateEnabled = false;
+	}
 
-	GLuint matCameraToWorldID = glGetUniformLocation(shaderProgramID, "matCameraToWorld");
+	//The denoiser works on the raw render targets, which only hold every pixel where it belongs when none are skipped
+	if (denoiseEnabled) {
+		checkerboardEnabled = false;
+		variableRateEnabled = false;
+	}
 
-	//-----------------------------------Sets up the actual world-----------------------------------
-	vec3 sunRevolutionAxis = vec3(0, sinf(radians(90 - sunMaxElevation)), cosf(radians(90 - sunMaxElevation)));
+	//Progressive frames build on what's in the render targets from one sample to the next, which skipping pixels would throw off
+	if (progressiveEnabled) {
+		checkerboardEnabled = false;
+		variableRateEnabled = false;
+		wavefrontEnabled = false;
+		createAccumulationTargets(marcherTargetWidth, marcherTargetHeight);
+	}
+
+	//The offline modes do their thing and quit without ever entering the interactive loop
+	if (isOffline) {
+		int result = isWorker ? runWorker(argc, argv) : runBenchmark(argc, argv);
+		glfwTerminate();
+		return result;
+	}
+
+	//The music is the clock, so the picture can't drift away from it. Without it, say if there's no sound device, the wall clock stands in.
+	bool musicIsClock = startAudioPlayback(musicPath);
 
-	//Start playing music
-	PlaySound(TEXT("music.wav"), NULL, SND_FILENAME | SND_ASYNC);
-	
-	double lastTime = glfwGetTime();
 	double startTime = glfwGetTime();
+	double lastTime = startTime;
+
+	//The playhead and camera live out here and in the preparer, so they carry straight on through any shader reloads
+	startShaderReloader();
+
+	//Stats are sampled and served on a thread of their own. The loop below only ever bumps counters.
+	if (statsSocketPath != NULL) {
+		if (startStatsServer(statsSocketPath)) createMarchStatsReadback();
+		else statsSocketPath = NULL;
+	}
+
+	//The first frame's params are made up front. After that, each frame's are made while the one before it is being drawn.
+	startFramePreparer();
+	requestFrameParams(0, 0, findCameraRotation());
 	do {
 
+		//Frame boundaries are the only place a program can safely change
+		applyReloadedShaders();
+
+		//Picks up the params the preparer made while the last frame was being drawn.
+		//Uploading them waits on the GPU only if it's a full maxFramesInFlight behind.
+		uploadFrameParams(waitForFrameParams());
+		bool samplingMarchStats = statsSocketPath != NULL && startMarchStatsSample();
+		renderFrame();
+		if (samplingMarchStats) finishMarchStatsSample();
+		fenceFrame();
+
 		//Finds delta time
 
 		double currentTime = glfwGetTime();
 		float deltaTime = float(currentTime - lastTime);
 		lastTime = currentTime;
-		float timeSinceStart = float(currentTime - startTime);
-
-		//Finds the camera rotation
-		
-		mat4 matCameraYaw = rotate(mat4(1.0f), cameraYaw, vec3(0, 1, 0));
-		mat4 matCameraPitch = rotate(mat4(1.0f), cameraPitch, vec3(1, 0, 0));
-
-		//Finds the camera translation
-
-		if (wDown && !sDown) {
-			cameraPos -= vec3(matCameraYaw * matCameraPitch * vec4(0, 0, 1, 0)) * cameraSpeed * deltaTime;
-		}
-		else if (!wDown && sDown) {
-			cameraPos += vec3(matCameraYaw * matCameraPitch * vec4(0, 0, 1, 0)) * cameraSpeed * deltaTime;
-		}
-
-		if (aDown && !dDown) {
-			cameraPos -= vec3(matCameraYaw * matCameraPitch * vec4(1, 0, 0, 0)) * cameraSpeed * deltaTime;
-		}
-		else if (!aDown && dDown) {
-			cameraPos += vec3(matCameraYaw * matCameraPitch * vec4(1, 0, 0, 0)) * cameraSpeed * deltaTime;
-		}
-
-		if (shiftDown && !spaceDown) {
-			cameraPos -= vec3(0, 1, 0) * cameraSpeed * deltaTime;
-		}
-		else if (!shiftDown && spaceDown) {
-			cameraPos += vec3(0, 1, 0) * cameraSpeed * deltaTime;
-		}
-
-		cameraPos += animate(keyFramesCamVel, keyFramesCamVelCount, timeSinceStart) * deltaTime;
-
-		mat4 matCameraTranslation = translate(mat4(1.0f), cameraPos);
-
-		//Unifies the camera transform
-		mat4 matCameraToWorld = matCameraTranslation * matCameraYaw * matCameraPitch;
-
-		//Finds the sun direction and sky color.
-		float daysSinceStart = timeSinceStart / dayLength;
-		vec3 skyColor = mix(skyColorNight, skyColorDay, 1.0f / (1 + exp(-skyColorLogB * sin(2 * pi<float>() * daysSinceStart))));
-		vec3 sunDirection = vec3(rotate(mat4(1.0f), radians(animate(keyFramesSunAngle, keyFramesSunAngleCount, timeSinceStart)), sunRevolutionAxis) * vec4(1, 0, 0, 0));
-
-		
-		//--------------------Uniform handoffs-------------------------------
-		glUniform3fv(ballsDiffuseID, 1, &animate<vec3>(keyFramesBallsDiffuse, keyFramesBallsDiffuseCount, timeSinceStart)[0]);
-		glUniform3fv(ballsSpecularID, 1, &vec3(0, 0, 0)[0]);
-		glUniform1f(ballsShininessID, 64.0f);
-
-		glUniform3fv(floorDiffuseID, 1, &vec3(1, 1, 1)[0]);
-		glUniform3fv(floorSpecularID, 1, &vec3(0, 0, 0)[0]);
-		glUniform1f(floorShininessID, 32.0f);
-
-		glUniform3fv(ambientLightID, 1, &animate<vec3>(keyFramesAmbientLight, keyFramesAmbientLightCount, timeSinceStart)[0]);
-		glUniform1i(doLambertianID, animate<bool>(keyFramesDoLambertian, keyFramesDoLambertianCount, timeSinceStart) ? 1 : 0);
-
-		glUniform3fv(sunDirectionID, 1, &sunDirection[0]);
-		glUniform3fv(skyColorID, 1, &animate<vec3>(keyFramesSkyColor, keyFramesSkyColorCount, timeSinceStart)[0]);
-		glUniform3fv(sunColorID, 1, &vec3(0, 0, 0)[0]);
-		glUniform1f(sunShininess, 1024);
-		glUniform1f(sunOverSat, 1);
-		
-		glUniformMatrix4fv(matCameraToWorldID, 1, FALSE, &matCameraToWorld[0][0]);
-		
-		//Run the shaders
-		glDispatchCompute(width, height, 1);
-
-		//Don't continue until the ray-marcher has finished
-		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-		
-		//Switch to the image-drawing shader
-		glUseProgram(shaderProgramID);
-		//Send the vertex position data to the shader program
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, verticesBufferID);
-		glVertexAttribPointer(
-			0,
-			3,
-			GL_FLOAT,
-			GL_FALSE,
-			0,
-			(void*)0
-		);
-
-		//Send the uv data to the shader program
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, uvsBufferID);
-		glVertexAttribPointer(
-			1,
-			2,
-			GL_FLOAT,
-			GL_FALSE,
-			0,
-			(void*)0
-		);
-
-		//Send the ray direction data to the shader program
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, rayDirectionBufferID);
-		glVertexAttribPointer(
-			2,
-			3,
-			GL_FLOAT,
-			GL_FALSE,
-			0,
-			(void*)0
-		);
-		
-		//Draw the full screen quad
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indicesBufferID);
-		glDrawElements(
-			GL_TRIANGLES,
-			6,
-			GL_UNSIGNED_SHORT,
-			(void*)0
-		);
+		recordFrameTime(deltaTime);
+
+		//Starts on the next frame while the GPU marches this one.
+		//When the next frame will actually happen isn't known yet, so guess it'll take as long as this one did.
+		double timeSinceStart = musicIsClock ? findAudioPlaybackTime() : currentTime - startTime;
+		float nextTimeSinceStart = float(timeSinceStart + deltaTime);
+		requestFrameParams(nextTimeSinceStart, deltaTime, findCameraRotation());
 
 		// Swap buffers
 		glfwSwapBuffers(window);
@@ -446,12 +1036,1183 @@ int main(void)
 	while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
 		glfwWindowShouldClose(window) == 0);
 
+	stopFramePreparer();
+	stopShaderReloader();
+	stopStatsServer();
+	stopAudioPlayback();
+	closeAudioSpectrum(musicSpectrum);
+
 	// Close OpenGL window and terminate GLFW
 	glfwTerminate();
 
 	return 0;
 }
 
+//Everything else the marcher needs comes through the FrameParams block, which is bound by number rather than looked up.
+void findUniformHandles(GLuint shaderProgramID) {
+	progressiveEnabledID = glGetUniformLocation(shaderProgramID, "progressiveEnabled");
+	progressiveSampleIndexID = glGetUniformLocation(shaderProgramID, "progressiveSampleIndex");
+	progressiveMinSamplesID = glGetUniformLocation(shaderProgramID, "progressiveMinSamples");
+	progressiveVarianceThresholdID = glGetUniformLocation(shaderProgramID, "progressiveVarianceThreshold");
+}
+
+mat4 findCameraRotation() {
+	mat4 matCameraYaw = rotate(mat4(1.0f), cameraYaw, vec3(0, 1, 0));
+	mat4 matCameraPitch = rotate(mat4(1.0f), cameraPitch, vec3(1, 0, 0));
+	return matCameraYaw * matCameraPitch;
+}
+
+//Hands every keyframe list to the registry whose block it's written into. The lists aren't looked at again after this.
+void registerAnimationTracks() {
+	addAnimationTrack(frameParamsTracks, keyFramesBallsDiffuse, keyFramesBallsDiffuseCount, offsetof(FrameParams, ballsDiffuse));
+	addAnimationTrack(frameParamsTracks, keyFramesDoLambertian, keyFramesDoLambertianCount, offsetof(FrameParams, doLambertian));
+	addAnimationTrack(frameParamsTracks, keyFramesAmbientLight, keyFramesAmbientLightCount, offsetof(FrameParams, ambientLight));
+	addAnimationTrack(frameParamsTracks, keyFramesSkyColor, keyFramesSkyColorCount, offsetof(FrameParams, skyColor));
+
+	addAnimationTrack(timelineTracks, keyFramesSunAngle, keyFramesSunAngleCount, offsetof(TimelineValues, sunAngle));
+	addAnimationTrack(timelineTracks, keyFramesPointLightIntensity, keyFramesPointLightIntensityCount, offsetof(TimelineValues, pointLightIntensity));
+	addAnimationTrack(timelineTracks, keyFramesCamVel, keyFramesCamVelCount, offsetof(TimelineValues, cameraVelocity));
+	addAnimationTrack(timelineTracks, keyFramesCamOrientation, keyFramesCamOrientationCount, offsetof(TimelineValues, cameraOrientation));
+}
+
+//Maps the music's baked spectrum and gives each band a track into FrameParams' audioBands. Without it, the bands just stay at 0.
+//The spectrum's a table with a row per frame, so each band's track is one column of it.
+void registerMusicSpectrum() {
+	if (openAudioSpectrum(musicSpectrumPath, musicSpectrum)) {
+		for (int band = 0; band < AUDIO_SPECTRUM_BANDS; band++) {
+			addSampledAnimationTrack(frameParamsTracks, musicSpectrum.bands + band, musicSpectrum.header->frameCount, AUDIO_SPECTRUM_BANDS,
+				musicSpectrum.header->framesPerSecond, offsetof(FrameParams, audioBands) + band * sizeof(float));
+		}
+	}
+}
+
+//Moves the camera by one frame's worth of keyboard input, plus whatever velocity the timeline gives it.
+void updateCameraPosition(mat4 matCameraRotation, float timeSinceStart, float deltaTime) {
+	if (wDown && !sDown) {
+		cameraPos -= dvec3(vec3(matCameraRotation * vec4(0, 0, 1, 0)) * cameraSpeed * deltaTime);
+	}
+	else if (!wDown && sDown) {
+		cameraPos += dvec3(vec3(matCameraRotation * vec4(0, 0, 1, 0)) * cameraSpeed * deltaTime);
+	}
+
+	if (aDown && !dDown) {
+		cameraPos -= dvec3(vec3(matCameraRotation * vec4(1, 0, 0, 0)) * cameraSpeed * deltaTime);
+	}
+	else if (!aDown && dDown) {
+		cameraPos += dvec3(vec3(matCameraRotation * vec4(1, 0, 0, 0)) * cameraSpeed * deltaTime);
+	}
+
+	if (shiftDown && !spaceDown) {
+		cameraPos -= dvec3(vec3(0, 1, 0) * cameraSpeed * deltaTime);
+	}
+	else if (!shiftDown && spaceDown) {
+		cameraPos += dvec3(vec3(0, 1, 0) * cameraSpeed * deltaTime);
+	}
+
+	TimelineValues timeline;
+	evaluateAnimation(timelineTracks, timeSinceStart, &timeline);
+	cameraPos += dvec3(timeline.cameraVelocity * deltaTime);
+}
+
+//The shader works in a local frame that's rebased every frame onto the corner of the repetition cell the camera is in.
+//Moving by whole cells doesn't change what deformation() makes of a point, so the picture is the same,
+//but the shader only ever sees small numbers, and keeps full float precision however far the camera has flown.
+//The scene doesn't repeat vertically, so y stays as it is.
+dvec3 findWorldOrigin(dvec3 position) {
+	return dvec3(
+		floor(position.x / sceneRepetitionPeriod) * sceneRepetitionPeriod,
+		0,
+		floor(position.z / sceneRepetitionPeriod) * sceneRepetitionPeriod
+	);
+}
+
+//Evaluates the timeline at timeSinceStart. This doesn't touch OpenGL, so it's safe to call from the frame preparer.
+FrameParams evaluateFrame(float timeSinceStart, mat4 matCameraRotation) {
+	steady_clock::time_point evaluationStart = steady_clock::now();
+	FrameParams frameParams;
+	TimelineValues timeline;
+
+	//Nothing writes the bands if the spectrum isn't there
+	for (int i = 0; i < AUDIO_SPECTRUM_BANDS / 4; i++) {
+		frameParams.audioBands[i] = vec4(0, 0, 0, 0);
+	}
+	evaluateAnimation(frameParamsTracks, timeSinceStart, &frameParams);
+	evaluateAnimation(timelineTracks, timeSinceStart, &timeline);
+
+	dvec3 worldOrigin = findWorldOrigin(cameraPos);
+	mat4 matCameraTranslation = translate(mat4(1.0f), vec3(cameraPos - worldOrigin));
+
+	//Unifies the camera transform
+	matCameraRotation = matCameraRotation * toMat4(timeline.cameraOrientation);
+	frameParams.matCameraToWorld = matCameraTranslation * matCameraRotation;
+
+	//Finds the sun direction.
+	vec3 sunDirection = vec3(rotate(mat4(1.0f), radians(timeline.sunAngle), sunRevolutionAxis) * vec4(1, 0, 0, 0));
+
+	frameParams.ballsSpecular = vec3(0, 0, 0);
+	frameParams.ballsShininess = 64.0f;
+
+	frameParams.floorDiffuse = vec3(1, 1, 1);
+	frameParams.floorSpecular = vec3(0, 0, 0);
+	frameParams.floorShininess = 32.0f;
+
+	frameParams.sunDirection = sunDirection;
+	frameParams.sunColor = vec3(0, 0, 0);
+	frameParams.sunShininess = 1024;
+	frameParams.sunOverSat = 1;
+
+	//Reprojection needs to know where the camera was last frame. The very first frame just pretends it hasn't moved.
+	//Last frame's camera is placed relative to this frame's origin, since the origin may have moved since.
+	if (!hasPreviousCamera) {
+		previousCameraPos = cameraPos;
+		previousMatCameraRotation = matCameraRotation;
+		hasPreviousCamera = true;
+	}
+	mat4 matPreviousCameraToWorld = translate(mat4(1.0f), vec3(previousCameraPos - worldOrigin)) * previousMatCameraRotation;
+	frameParams.matWorldToPreviousCamera = inverse(matPreviousCameraToWorld);
+	previousCameraPos = cameraPos;
+	previousMatCameraRotation = matCameraRotation;
+	frameParams.screenTop = viewScreenTop;
+	frameParams.screenRight = viewScreenRight;
+
+	frameParams.viewCount = viewCount;
+
+	frameParams.variableRateEnabled = variableRateEnabled ? 1 : 0;
+	frameParams.variableRateFoveated = variableRateFoveated ? 1 : 0;
+	frameParams.variableRateDebugView = variableRateDebugView ? 1 : 0;
+
+	frameParams.tileCullEnabled = tileCullEnabled && viewCount == 1 ? 1 : 0;
+	for (int view = 0; view < viewCount; view++) {
+		frameParams.matViewToCamera[view] = matViewToCamera[view];
+	}
+
+	frameParams.targetSize = ivec2(marcherTargetWidth, marcherTargetHeight);
+	frameParams.checkerboardEnabled = checkerboardEnabled ? 1 : 0;
+	frameParams.wavefrontEnabled = wavefrontEnabled && viewCount == 1 && !checkerboardEnabled && !variableRateEnabled && !progressiveEnabled ? 1 : 0;
+	frameParams.checkerboardPhase = checkerboardFrameIndex & 1;
+	checkerboardFrameIndex++;
+
+	frameParams.matWorldToView = inverse(frameParams.matCameraToWorld * matViewToCamera[0]);
+	frameParams.pointLightCount = pointLightsEnabled && viewCount == 1 ? placePointLights(frameParams, worldOrigin, timeSinceStart,
+		timeline.pointLightIntensity * (1 + frameParams.audioBands[0].x * pointLightBassPulse)) : 0;
+	frameParams.pointLightShadowBudget = pointLightShadowBudget;
+	frameParams.ssaoEnabled = ssaoEnabled && viewCount == 1 && !checkerboardEnabled && !variableRateEnabled && !progressiveEnabled ? 1 : 0;
+
+	recordAnimationEvaluation(duration<double>(steady_clock::now() - evaluationStart).count());
+	return frameParams;
+}
+
+//Fills in frameParams' point lights around the camera, relative to worldOrigin, and returns how many there are.
+//Each ball's lights start around it at an angle picked by which cell it's in, so they're the same lights whichever cell the origin is.
+int placePointLights(FrameParams & frameParams, dvec3 worldOrigin, float timeSinceStart, float intensity) {
+	vec3 cameraLocal = vec3(cameraPos - worldOrigin);
+	int lightCount = 0;
+	for (int cellX = pointLightFirstCell; cellX <= pointLightLastCell; cellX++) {
+		for (int cellZ = pointLightFirstCell; cellZ <= pointLightLastCell; cellZ++) {
+			long long absoluteCellX = (long long)round(worldOrigin.x / sceneRepetitionPeriod) + cellX;
+			long long absoluteCellZ = (long long)round(worldOrigin.z / sceneRepetitionPeriod) + cellZ;
+			unsigned int cellHash = (unsigned int)(absoluteCellX * 73856093LL) ^ (unsigned int)(absoluteCellZ * 19349663LL);
+			float cellPhase = (cellHash % 1024) / 1024.0f * 2 * pi<float>();
+			vec3 ballCenter = vec3(cellX * sceneRepetitionPeriod, 0, cellZ * sceneRepetitionPeriod);
+
+			for (int light = 0; light < pointLightsPerBall; light++) {
+				float direction = light % 2 == 0 ? 1.0f : -1.0f;
+				float angle = cellPhase + direction * pointLightOrbitSpeed * timeSinceStart + light * pi<float>();
+				vec3 position = ballCenter + vec3(cos(angle) * pointLightOrbitRadius, pointLightHeights[light], sin(angle) * pointLightOrbitRadius);
+				float fade = clamp((pointLightFadeEnd - length(position - cameraLocal)) / (pointLightFadeEnd - pointLightFadeStart), 0.0f, 1.0f);
+				if (fade <= 0 || lightCount == MAX_POINT_LIGHTS) continue;
+
+				frameParams.pointLightPositions[lightCount] = vec4(position, 1);
+				frameParams.pointLightColors[lightCount] = vec4(pointLightPalette[cellHash % pointLightPaletteSize] * intensity * fade, 1);
+				lightCount++;
+			}
+		}
+	}
+	return lightCount;
+}
+
+//Makes the persistently mapped buffer that holds a FrameParams slot for each frame in flight.
+void createFrameParamsBuffer() {
+	//Each slot has to start on a uniform buffer offset boundary
+	GLint offsetAlignment;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+	frameParamsSlotSize = ((sizeof(FrameParams) + offsetAlignment - 1) / offsetAlignment) * offsetAlignment;
+
+	GLbitfield mapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &frameParamsBufferID);
+	glBindBuffer(GL_UNIFORM_BUFFER, frameParamsBufferID);
+	glBufferStorage(GL_UNIFORM_BUFFER, frameParamsSlotSize * framesInFlightLimit, NULL, mapFlags);
+	frameParamsMapping = (unsigned char *)glMapBufferRange(GL_UNIFORM_BUFFER, 0, frameParamsSlotSize * framesInFlightLimit, mapFlags);
+
+	for (int slot = 0; slot < framesInFlightLimit; slot++) {
+		frameParamsFences[slot] = 0;
+	}
+}
+
+//Copies a frame's params into the next slot and binds it for the marcher.
+//If the GPU hasn't finished the frame that last used the slot, this waits for it. That's the only place the CPU ever waits on the GPU.
+void uploadFrameParams(const FrameParams & frameParams) {
+	frameParamsSlot = (frameParamsSlot + 1) % maxFramesInFlight;
+
+	GLsync & fence = frameParamsFences[frameParamsSlot];
+	if (fence != 0) {
+		while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(fence);
+		fence = 0;
+	}
+
+	memcpy(frameParamsMapping + frameParamsSlot * frameParamsSlotSize, &frameParams, sizeof(FrameParams));
+	currentFrameParams = frameParams;
+	glBindBufferRange(GL_UNIFORM_BUFFER, 0, frameParamsBufferID, frameParamsSlot * frameParamsSlotSize, sizeof(FrameParams));
+}
+
+//Marks the end of the current frame's GPU work, so its params slot can be reused once the GPU gets there.
+void fenceFrame() {
+	frameParamsFences[frameParamsSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void startFramePreparer() {
+	framePreparerThread = std::thread([]() {
+		while (true) {
+			std::unique_lock<std::mutex> lock(framePreparerMutex);
+			framePreparerCondition.wait(lock, []() { return framePreparerHasRequest || framePreparerQuitting; });
+			if (framePreparerQuitting) return;
+			framePreparerHasRequest = false;
+			float timeSinceStart = framePreparerTime;
+			float deltaTime = framePreparerDeltaTime;
+			mat4 matCameraRotation = framePreparerCameraRotation;
+			lock.unlock();
+
+			//The preparer is the only thing that moves the camera while it's running
+			updateCameraPosition(matCameraRotation, timeSinceStart, deltaTime);
+			FrameParams frameParams = evaluateFrame(timeSinceStart, matCameraRotation);
+
+			lock.lock();
+			framePreparerResult = frameParams;
+			framePreparerHasResult = true;
+			framePreparerCondition.notify_all();
+		}
+	});
+}
+
+//Asks the preparer for a frame's params. Pick them up with waitForFrameParams.
+void requestFrameParams(float timeSinceStart, float deltaTime, mat4 matCameraRotation) {
+	std::lock_guard<std::mutex> lock(framePreparerMutex);
+	framePreparerTime = timeSinceStart;
+	framePreparerDeltaTime = deltaTime;
+	framePreparerCameraRotation = matCameraRotation;
+	framePreparerHasRequest = true;
+	framePreparerCondition.notify_all();
+}
+
+FrameParams waitForFrameParams() {
+	std::unique_lock<std::mutex> lock(framePreparerMutex);
+	framePreparerCondition.wait(lock, []() { return framePreparerHasResult; });
+	framePreparerHasResult = false;
+	return framePreparerResult;
+}
+
+void stopFramePreparer() {
+	{
+		std::lock_guard<std::mutex> lock(framePreparerMutex);
+		framePreparerQuitting = true;
+		framePreparerCondition.notify_all();
+	}
+	framePreparerThread.join();
+}
+
+//Makes the persistently mapped buffer sampled march statistics are copied into, for the CPU to read without waiting.
+void createMarchStatsReadback() {
+	GLbitfield mapFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &marchStatsReadbackBufferID);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, marchStatsReadbackBufferID);
+	glBufferStorage(GL_COPY_WRITE_BUFFER, MARCH_STATS_COUNT * sizeof(GLuint), NULL, mapFlags);
+	marchStatsReadbackMapping = (GLuint *)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, MARCH_STATS_COUNT * sizeof(GLuint), mapFlags);
+}
+
+//Hands the last sampled frame's march statistics to the stats server if the GPU is done with them, then decides whether this frame gets sampled.
+//If it does, the statistics are zeroed and switched on, and this returns true. Call finishMarchStatsSample once the frame is drawn.
+bool startMarchStatsSample() {
+	if (marchStatsReadbackFence != 0) {
+		if (glClientWaitSync(marchStatsReadbackFence, 0, 0) == GL_TIMEOUT_EXPIRED) return false;
+		glDeleteSync(marchStatsReadbackFence);
+		marchStatsReadbackFence = 0;
+		recordMarchStats(marchStatsReadbackMapping[MARCH_STATS_STEPS_TOTAL], marchStatsReadbackMapping[MARCH_STATS_STEPS_MAX],
+			marchStatsReadbackMapping[MARCH_STATS_MAX_ITERS_PIXELS], marchStatsReadbackMapping[MARCH_STATS_MARCHED_PIXELS]);
+	}
+
+	if (++framesSinceMarchStatsSample < marchStatsSampleInterval) return false;
+	framesSinceMarchStatsSample = 0;
+	glClearNamedBufferData(marchStatsBufferID, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	setCollectMarchStats(true);
+	return true;
+}
+
+//Switches the statistics back off and queues up their copy into the readback buffer, behind the frame that wrote them.
+void finishMarchStatsSample() {
+	setCollectMarchStats(false);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glCopyNamedBufferSubData(marchStatsBufferID, marchStatsReadbackBufferID, 0, 0, MARCH_STATS_COUNT * sizeof(GLuint));
+	marchStatsReadbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+//Switches collectMarchStats on or off in every program that marches rays, so the statistics cover whichever path draws the frame.
+//It's looked up each time rather than kept, since this only happens every so often and reloading a program can move it.
+void setCollectMarchStats(bool enabled) {
+	GLuint programIDs[] = { marcherProgramID, variableRateMarcherProgramID, wavefrontPrimaryProgramID, wavefrontShadowProgramID };
+	for (GLuint programID : programIDs) {
+		glProgramUniform1i(programID, glGetUniformLocation(programID, "collectMarchStats"), enabled ? 1 : 0);
+	}
+}
+
+//Draws the full screen quad with whatever program is currently bound.
+void drawScreenQuad(int instanceCount) {
+	//Send the vertex position data to the shader program
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, verticesBufferID);
+	glVertexAttribPointer(
+		0,
+		3,
+		GL_FLOAT,
+		GL_FALSE,
+		0,
+		(void*)0
+	);
+
+	//Send the uv data to the shader program
+	glEnableVertexAttribArray(1);
+	glBindBuffer(GL_ARRAY_BUFFER, uvsBufferID);
+	glVertexAttribPointer(
+		1,
+		2,
+		GL_FLOAT,
+		GL_FALSE,
+		0,
+		(void*)0
+	);
+
+	//Draw the full screen quad, once per instance
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indicesBufferID);
+	glDrawElementsInstanced(
+		GL_TRIANGLES,
+		6,
+		GL_UNSIGNED_SHORT,
+		(void*)0,
+		instanceCount
+	);
+}
+
+//(Re)makes the marcher's render targets at the given size, in whatever formats renderTargetFormats says.
+//With more than one layer, they're array textures with a layer per view, for multi-view rendering.
+void createMarcherTargets(int targetWidth, int targetHeight, int layers) {
+	if (marcherFramebufferID != 0) {
+		glDeleteFramebuffers(1, &marcherFramebufferID);
+		glDeleteTextures(RENDER_TARGET_COUNT, renderTargetTextureIDs);
+		glDeleteFramebuffers(2, checkerboardHistoryFramebufferIDs);
+		glDeleteTextures(2, checkerboardHistoryTextureIDs);
+		glDeleteFramebuffers(1, &variableRateResolvedFramebufferID);
+		glDeleteTextures(1, &variableRateResolvedTextureID);
+		glDeleteTextures(1, &variableRateMapTextureID);
+		glDeleteTextures(1, &tileStartDistancesTextureID);
+		glDeleteBuffers(1, &wavefrontQueuesBufferID);
+		glDeleteBuffers(1, &wavefrontHitsBufferID);
+		glDeleteBuffers(1, &wavefrontShadowRaysBufferID);
+		glDeleteBuffers(1, &wavefrontSunVisibilitiesBufferID);
+		glDeleteBuffers(1, &wavefrontBlockedPointLightsBufferID);
+		glDeleteBuffers(1, &lightClustersBufferID);
+		glDeleteTextures(1, &ssaoTextureID);
+		glDeleteFramebuffers(1, &ssaoFramebufferID);
+	}
+	marcherTargetWidth = targetWidth;
+	marcherTargetHeight = targetHeight;
+
+	glGenFramebuffers(1, &marcherFramebufferID);
+	glBindFramebuffer(GL_FRAMEBUFFER, marcherFramebufferID);
+
+	GLenum textureTarget = layers > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+	glGenTextures(RENDER_TARGET_COUNT, renderTargetTextureIDs);
+	GLenum drawBuffers[RENDER_TARGET_COUNT];
+	for (int target = 0; target < RENDER_TARGET_COUNT; target++) {
+		glBindTexture(textureTarget, renderTargetTextureIDs[target]);
+		if (layers > 1) {
+			glTexStorage3D(textureTarget, 1, renderTargetFormats[target].internalFormat, targetWidth, targetHeight, layers);
+		}
+		else {
+			glTexStorage2D(textureTarget, 1, renderTargetFormats[target].internalFormat, targetWidth, targetHeight);
+		}
+		//Integer textures can't be filtered, and nothing wants the others filtered either
+		glTexParameteri(textureTarget, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(textureTarget, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(textureTarget, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(textureTarget, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		//Attaching the whole texture makes the framebuffer layered when it's an array, so each quad instance can pick its layer
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + target, renderTargetTextureIDs[target], 0);
+		drawBuffers[target] = GL_COLOR_ATTACHMENT0 + target;
+	}
+	glDrawBuffers(RENDER_TARGET_COUNT, drawBuffers);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr, "The marcher's render targets aren't a usable framebuffer\n");
+	}
+
+	//The checkerboard history holds finished color, so it's stored like the color target.
+	//It's sampled between pixels when reprojecting, so unlike the targets it gets filtered.
+	glGenTextures(2, checkerboardHistoryTextureIDs);
+	glGenFramebuffers(2, checkerboardHistoryFramebufferIDs);
+	for (int i = 0; i < 2; i++) {
+		glBindTexture(GL_TEXTURE_2D, checkerboardHistoryTextureIDs[i]);
+		glTexStorage2D(GL_TEXTURE_2D, 1, renderTargetFormats[RENDER_TARGET_COLOR].internalFormat, targetWidth, targetHeight);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		float black[4] = { 0, 0, 0, 0 };
+		glClearTexImage(checkerboardHistoryTextureIDs[i], 0, GL_RGBA, GL_FLOAT, black);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, checkerboardHistoryFramebufferIDs[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, checkerboardHistoryTextureIDs[i], 0);
+	}
+
+	//The rate map is read by the marcher as a texture, and rewritten by VariableRateMap.glsl as an image
+	variableRateMapWidth = (targetWidth + variableRateTileSize - 1) / variableRateTileSize;
+	variableRateMapHeight = (targetHeight + variableRateTileSize - 1) / variableRateTileSize;
+	glGenTextures(1, &variableRateMapTextureID);
+	glBindTexture(GL_TEXTURE_2D, variableRateMapTextureID);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8UI, variableRateMapWidth, variableRateMapHeight);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTextureUnit(4, variableRateMapTextureID);
+	glBindImageTexture(3, variableRateMapTextureID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R8UI);
+	variableRateWasEnabled = false;
+
+	glGenTextures(1, &variableRateResolvedTextureID);
+	glBindTexture(GL_TEXTURE_2D, variableRateResolvedTextureID);
+	glTexStorage2D(GL_TEXTURE_2D, 1, renderTargetFormats[RENDER_TARGET_COLOR].internalFormat, targetWidth, targetHeight);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glGenFramebuffers(1, &variableRateResolvedFramebufferID);
+	glBindFramebuffer(GL_FRAMEBUFFER, variableRateResolvedFramebufferID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, variableRateResolvedTextureID, 0);
+
+	tileCullWidth = (targetWidth + tileCullSize - 1) / tileCullSize;
+	tileCullHeight = (targetHeight + tileCullSize - 1) / tileCullSize;
+	glGenTextures(1, &tileStartDistancesTextureID);
+	glBindTexture(GL_TEXTURE_2D, tileStartDistancesTextureID);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, tileCullWidth, tileCullHeight);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTextureUnit(5, tileStartDistancesTextureID);
+	glBindImageTexture(4, tileStartDistancesTextureID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+	//Every pixel can have a hit, and a shadow ray for the sun and for each point light it has the budget for, each a vec3 and a uint.
+	//Then a sun visibility and a mask of blocked point lights.
+	GLsizeiptr pixelCount = (GLsizeiptr)targetWidth * targetHeight;
+	glCreateBuffers(1, &wavefrontQueuesBufferID);
+	glNamedBufferStorage(wavefrontQueuesBufferID, sizeof(WavefrontQueueHeader), NULL, GL_DYNAMIC_STORAGE_BIT);
+	glCreateBuffers(1, &wavefrontHitsBufferID);
+	glNamedBufferStorage(wavefrontHitsBufferID, pixelCount * 4 * sizeof(GLuint), NULL, 0);
+	glCreateBuffers(1, &wavefrontShadowRaysBufferID);
+	glNamedBufferStorage(wavefrontShadowRaysBufferID, pixelCount * (1 + pointLightShadowBudget) * 4 * sizeof(GLuint), NULL, 0);
+	glCreateBuffers(1, &wavefrontSunVisibilitiesBufferID);
+	glNamedBufferStorage(wavefrontSunVisibilitiesBufferID, pixelCount * sizeof(GLfloat), NULL, 0);
+	glCreateBuffers(1, &wavefrontBlockedPointLightsBufferID);
+	glNamedBufferStorage(wavefrontBlockedPointLightsBufferID, pixelCount * sizeof(GLuint), NULL, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, wavefrontQueuesBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, wavefrontHitsBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, wavefrontShadowRaysBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, wavefrontSunVisibilitiesBufferID);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, wavefrontBlockedPointLightsBufferID);
+
+	//The header's only written here. LightCull.glsl fills in the masks every frame.
+	lightClusterTilesWide = (targetWidth + LIGHT_CLUSTER_TILE_SIZE - 1) / LIGHT_CLUSTER_TILE_SIZE;
+	lightClusterTilesHigh = (targetHeight + LIGHT_CLUSTER_TILE_SIZE - 1) / LIGHT_CLUSTER_TILE_SIZE;
+	GLuint lightClustersHeader[2] = { lightClusterTilesWide, lightClusterTilesHigh };
+	GLsizeiptr froxelCount = (GLsizeiptr)lightClusterTilesWide * lightClusterTilesHigh * LIGHT_CLUSTER_SLICES;
+	glCreateBuffers(1, &lightClustersBufferID);
+	glNamedBufferStorage(lightClustersBufferID, sizeof(lightClustersHeader) + froxelCount * sizeof(GLuint), NULL, GL_DYNAMIC_STORAGE_BIT);
+	glNamedBufferSubData(lightClustersBufferID, 0, sizeof(lightClustersHeader), lightClustersHeader);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, lightClustersBufferID);
+
+	ssaoWidth = (targetWidth + 1) / 2;
+	ssaoHeight = (targetHeight + 1) / 2;
+	glGenTextures(1, &ssaoTextureID);
+	glBindTexture(GL_TEXTURE_2D, ssaoTextureID);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG32F, ssaoWidth, ssaoHeight);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindImageTexture(5, ssaoTextureID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+	glGenFramebuffers(1, &ssaoFramebufferID);
+	glBindFramebuffer(GL_FRAMEBUFFER, ssaoFramebufferID);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, renderTargetTextureIDs[RENDER_TARGET_COLOR], 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, outputFramebufferID);
+}
+
+//Handles one --target-format <target>=<format> selection, e.g. color=rgba16f.
+//The marcher writes steps as an integer, so it can only go in integer formats, and everything else only in float ones.
+bool selectRenderTargetFormat(const char * selection) {
+	std::string selectionString = selection;
+	size_t equalsIndex = selectionString.find('=');
+	std::string targetName = selectionString.substr(0, equalsIndex);
+	std::string formatName = equalsIndex == std::string::npos ? "" : selectionString.substr(equalsIndex + 1);
+
+	for (int target = 0; target < RENDER_TARGET_COUNT; target++) {
+		if (targetName != renderTargetNames[target]) continue;
+		for (int choice = 0; choice < renderTargetFormatChoiceCount; choice++) {
+			if (formatName != renderTargetFormatChoices[choice].name) continue;
+			if (renderTargetFormatChoices[choice].isInteger != renderTargetFormats[target].isInteger) {
+				fprintf(stderr, "The %s target can't be stored as %s\n", targetName.c_str(), formatName.c_str());
+				return false;
+			}
+			renderTargetFormats[target] = renderTargetFormatChoices[choice];
+			return true;
+		}
+		fprintf(stderr, "Unknown render target format %s\n", formatName.c_str());
+		return false;
+	}
+	fprintf(stderr, "Unknown render target %s\n", targetName.c_str());
+	return false;
+}
+
+//Makes a view looking along forward, with up at the top of its screen, from the camera's own position.
+mat4 viewFacing(vec3 forward, vec3 up) {
+	return mat4(vec4(cross(forward, up), 0), vec4(up, 0), vec4(-forward, 0), vec4(0, 0, 0, 1));
+}
+
+//Handles --views <mode>. Stereo is a left and right eye, each the size of the window.
+//Cubemap is six square 90 degree faces, in the order and orientation ffmpeg's v360 filter expects of a c1x6 cubemap:
+//right, left, up, down, front, back, with the up face's top toward the back and the down face's top toward the front.
+bool selectViewMode(const char * mode) {
+	if (strcmp(mode, "stereo") == 0) {
+		viewCount = 2;
+		matViewToCamera[0] = translate(mat4(1.0f), vec3(-stereoEyeSeparation / 2, 0, 0));
+		matViewToCamera[1] = translate(mat4(1.0f), vec3(stereoEyeSeparation / 2, 0, 0));
+		return true;
+	}
+	if (strcmp(mode, "cubemap") == 0) {
+		viewCount = 6;
+		matViewToCamera[0] = viewFacing(vec3(1, 0, 0), vec3(0, 1, 0));
+		matViewToCamera[1] = viewFacing(vec3(-1, 0, 0), vec3(0, 1, 0));
+		matViewToCamera[2] = viewFacing(vec3(0, 1, 0), vec3(0, 0, 1));
+		matViewToCamera[3] = viewFacing(vec3(0, -1, 0), vec3(0, 0, -1));
+		matViewToCamera[4] = viewFacing(vec3(0, 0, -1), vec3(0, 1, 0));
+		matViewToCamera[5] = viewFacing(vec3(0, 0, 1), vec3(0, 1, 0));
+		viewWidth = height;
+		viewHeight = height;
+		viewScreenTop = 1;
+		viewScreenRight = 1;
+		return true;
+	}
+	fprintf(stderr, "Unknown view mode %s. Pick stereo or cubemap.\n", mode);
+	return false;
+}
+
+//Makes the sky LUT and binds it where the marcher samples it from. It gets filled in on the first frame.
+void createSkyLUT() {
+	glGenTextures(1, &skyLUTTextureID);
+	glBindTexture(GL_TEXTURE_2D, skyLUTTextureID);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, skyLUTWidth, skyLUTHeight);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glBindTextureUnit(3, skyLUTTextureID);
+	glBindImageTexture(2, skyLUTTextureID, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+	skyLUTIsValid = false;
+}
+
+//Refills the sky LUT if anything it's made from has changed since it was last filled.
+void updateSkyLUT() {
+	const FrameParams & now = currentFrameParams;
+	const FrameParams & then = skyLUTFrameParams;
+	if (skyLUTIsValid &&
+		now.sunDirection == then.sunDirection &&
+		now.skyColor == then.skyColor &&
+		now.sunColor == then.sunColor &&
+		now.sunShininess == then.sunShininess &&
+		now.sunOverSat == then.sunOverSat) return;
+
+	glUseProgram(skyLUTProgramID);
+	glDispatchCompute((skyLUTWidth + 7) / 8, (skyLUTHeight + 7) / 8, 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	skyLUTFrameParams = currentFrameParams;
+	skyLUTIsValid = true;
+}
+
+//Marches the scene into the render targets, then presents the color target into the output framebuffer.
+//The frame's uniforms should already be set.
+void renderFrame() {
+	updateSkyLUT();
+
+	if (currentFrameParams.variableRateEnabled && !variableRateWasEnabled) {
+		GLubyte fullRate = 0;
+		glClearTexImage(variableRateMapTextureID, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &fullRate);
+	}
+	variableRateWasEnabled = currentFrameParams.variableRateEnabled != 0;
+
+	//The depth target is only bound so the culling knows the screen size. One thread does one tile.
+	if (currentFrameParams.tileCullEnabled) {
+		glUseProgram(tileCullProgramID);
+		glBindTextureUnit(0, renderTargetTextureIDs[RENDER_TARGET_DEPTH]);
+		glDispatchCompute((tileCullWidth + 7) / 8, (tileCullHeight + 7) / 8, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+	//Like tile culling, one thread does one froxel. With no lights, every pixel skips them without looking at its froxel.
+	if (currentFrameParams.pointLightCount > 0) {
+		glUseProgram(lightCullProgramID);
+		glBindTextureUnit(0, renderTargetTextureIDs[RENDER_TARGET_DEPTH]);
+		glDispatchCompute((lightClusterTilesWide + 7) / 8, (lightClusterTilesHigh + 7) / 8, LIGHT_CLUSTER_SLICES);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, marcherFramebufferID);
+	glViewport(0, 0, marcherTargetWidth, marcherTargetHeight);
+	if (currentFrameParams.wavefrontEnabled) {
+		marchWavefront();
+	}
+	else if (currentFrameParams.variableRateEnabled) {
+		//One quad per tile, only as big as the tile has blocks. See VariableRate.glsl.
+		glUseProgram(variableRateMarcherProgramID);
+		drawScreenQuad(variableRateMapWidth * variableRateMapHeight);
+	}
+	else {
+		//In checkerboard mode, a quad over the left half of the targets marches just this frame's half of the pixels. See Checkerboard.glsl.
+		if (currentFrameParams.checkerboardEnabled) glViewport(0, 0, (marcherTargetWidth + 1) / 2, marcherTargetHeight);
+		glUseProgram(marcherProgramID);
+		drawScreenQuad(viewCount);
+		glViewport(0, 0, marcherTargetWidth, marcherTargetHeight);
+	}
+
+	//There's no one place to present several views to. They get read straight out of the color target instead.
+	if (viewCount > 1) return;
+
+	if (currentFrameParams.ssaoEnabled) {
+		occludeAmbientLight();
+	}
+
+	GLuint finishedColorTextureID = renderTargetTextureIDs[RENDER_TARGET_COLOR];
+
+	//In checkerboard mode, the half the marcher skipped gets filled in from last frame's finished image
+	if (currentFrameParams.checkerboardEnabled) {
+		int previousIndex = checkerboardHistoryIndex;
+		checkerboardHistoryIndex = 1 - checkerboardHistoryIndex;
+
+		glBindFramebuffer(GL_FRAMEBUFFER, checkerboardHistoryFramebufferIDs[checkerboardHistoryIndex]);
+		glUseProgram(checkerboardResolveProgramID);
+		glBindTextureUnit(0, renderTargetTextureIDs[RENDER_TARGET_COLOR]);
+		glBindTextureUnit(1, renderTargetTextureIDs[RENDER_TARGET_DEPTH]);
+		glBindTextureUnit(2, checkerboardHistoryTextureIDs[previousIndex]);
+		drawScreenQuad();
+
+		finishedColorTextureID = checkerboardHistoryTextureIDs[checkerboardHistoryIndex];
+	}
+
+	//In variable-rate mode, each block's marched pixel gets spread over the block, then the rate map is worked out again for next frame
+	if (currentFrameParams.variableRateEnabled) {
+		glBindFramebuffer(GL_FRAMEBUFFER, variableRateResolvedFramebufferID);
+		glUseProgram(variableRateResolveProgramID);
+		glBindTextureUnit(0, renderTargetTextureIDs[RENDER_TARGET_COLOR]);
+		drawScreenQuad();
+
+		glUseProgram(variableRateMapProgramID);
+		glBindTextureUnit(0, renderTargetTextureIDs[RENDER_TARGET_STEPS]);
+		glBindTextureUnit(1, renderTargetTextureIDs[RENDER_TARGET_COLOR]);
+		glDispatchCompute(variableRateMapWidth, variableRateMapHeight, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		finishedColorTextureID = variableRateResolvedTextureID;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, outputFramebufferID);
+	glViewport(0, 0, marcherTargetWidth, marcherTargetHeight);
+	glUseProgram(presentProgramID);
+	glBindTextureUnit(0, finishedColorTextureID);
+	drawScreenQuad();
+}
+
+//Fills the marcher's render targets in wavefront mode, with the marcher's framebuffer bound.
+//The camera ray queue is every pixel, in blocks, so only its length gets written. Each stage's writes are finished before the next reads them.
+void marchWavefront() {
+	GLuint blocksWide = (marcherTargetWidth + wavefrontPixelBlockSize - 1) / wavefrontPixelBlockSize;
+	GLuint blocksHigh = (marcherTargetHeight + wavefrontPixelBlockSize - 1) / wavefrontPixelBlockSize;
+	WavefrontQueueHeader header = {};
+	header.queueLength[WAVEFRONT_QUEUE_PRIMARY] = blocksWide * blocksHigh * wavefrontPixelBlockSize * wavefrontPixelBlockSize;
+	header.targetWidth = marcherTargetWidth;
+	header.targetHeight = marcherTargetHeight;
+	glNamedBufferSubData(wavefrontQueuesBufferID, 0, sizeof(header), &header);
+
+	glUseProgram(wavefrontPrimaryProgramID);
+	glDispatchCompute(wavefrontPersistentGroupCount, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	glUseProgram(wavefrontShadowProgramID);
+	glDispatchCompute(wavefrontPersistentGroupCount, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	glUseProgram(wavefrontShadeProgramID);
+	drawScreenQuad();
+}
+
+//Darkens the ambient light in the color target where Ssao.glsl finds it occluded. One thread does one half resolution pixel.
+//The upsample's blending subtracts what it draws from what's there, so the color target's only written, never read.
+void occludeAmbientLight() {
+	glUseProgram(ssaoProgramID);
+	glBindTextureUnit(0, renderTargetTextureIDs[RENDER_TARGET_DEPTH]);
+	glBindTextureUnit(1, renderTargetTextureIDs[RENDER_TARGET_NORMAL]);
+	glDispatchCompute((ssaoWidth + 7) / 8, (ssaoHeight + 7) / 8, 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, ssaoFramebufferID);
+	glUseProgram(ssaoUpsampleProgramID);
+	glBindTextureUnit(0, renderTargetTextureIDs[RENDER_TARGET_DEPTH]);
+	glBindTextureUnit(1, renderTargetTextureIDs[RENDER_TARGET_AMBIENT]);
+	glBindTextureUnit(2, ssaoTextureID);
+	glEnable(GL_BLEND);
+	glBlendEquation(GL_FUNC_REVERSE_SUBTRACT);
+	glBlendFunc(GL_ONE, GL_ONE);
+	drawScreenQuad();
+	glBlendEquation(GL_FUNC_ADD);
+	glDisable(GL_BLEND);
+}
+
+//Makes the running sums progressive mode accumulates into, and binds them for the marcher.
+void createAccumulationTargets(int targetWidth, int targetHeight) {
+	glGenTextures(1, &accumulationTextureID);
+	glBindTexture(GL_TEXTURE_2D, accumulationTextureID);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, targetWidth, targetHeight);
+
+	glGenTextures(1, &accumulationLumaSquaresTextureID);
+	glBindTexture(GL_TEXTURE_2D, accumulationLumaSquaresTextureID);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, targetWidth, targetHeight);
+
+	glBindImageTexture(0, accumulationTextureID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+	glBindImageTexture(1, accumulationLumaSquaresTextureID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+}
+
+//Renders the current frame params over and over, averaging the samples, until every pixel has converged or progressiveMaxSamples runs out.
+//The color target holds the average once it's done. Returns how many samples it took.
+int renderProgressiveFrame() {
+	float zeros[4] = { 0, 0, 0, 0 };
+	glClearTexImage(accumulationTextureID, 0, GL_RGBA, GL_FLOAT, zeros);
+	glClearTexImage(accumulationLumaSquaresTextureID, 0, GL_RED, GL_FLOAT, zeros);
+
+	glProgramUniform1i(marcherProgramID, progressiveEnabledID, 1);
+	glProgramUniform1ui(marcherProgramID, progressiveMinSamplesID, progressiveMinSamples);
+	glProgramUniform1f(marcherProgramID, progressiveVarianceThresholdID, progressiveVarianceThreshold);
+
+	int sample = 0;
+	while (sample < progressiveMaxSamples) {
+		bool checkConvergence = (sample + 1) % progressiveCheckInterval == 0 && sample + 1 > progressiveMinSamples;
+		if (checkConvergence) {
+			GLuint zero = 0;
+			glNamedBufferSubData(marchStatsBufferID, MARCH_STATS_PROGRESSIVE_ACTIVE_PIXELS * sizeof(GLuint), sizeof(GLuint), &zero);
+		}
+
+		glProgramUniform1ui(marcherProgramID, progressiveSampleIndexID, sample);
+		renderFrame();
+		sample++;
+
+		//The next sample reads what this one wrote to the sums
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+		//No pixel took this sample, so they've all converged
+		if (checkConvergence) {
+			GLuint activePixels;
+			glGetNamedBufferSubData(marchStatsBufferID, MARCH_STATS_PROGRESSIVE_ACTIVE_PIXELS * sizeof(GLuint), sizeof(GLuint), &activePixels);
+			if (activePixels == 0) break;
+		}
+	}
+
+	glProgramUniform1i(marcherProgramID, progressiveEnabledID, 0);
+	return sample;
+}
+
+//The timeline is as long as its latest keyframe.
+float findTimelineLength() {
+	return std::max(findAnimationLength(frameParamsTracks), findAnimationLength(timelineTracks));
+}
+
+//--------------------------------------Offline rendering----------------------------------------
+
+//Renders frames [firstFrame, firstFrame + frameCount) and writes them, top row first, as raw 8 bit RGB to outputPath.
+//Usage: GravelMarcher --worker <firstFrame> <frameCount> <outputPath> [--fps n]
+//Progress goes to stdout one "FRAME n" line at a time, so whoever started the worker can follow along through the pipe.
+int runWorker(int argc, char* argv[]) {
+	if (argc < 5) {
+		fprintf(stderr, "Usage: GravelMarcher --worker <firstFrame> <frameCount> <outputPath> [--fps n] [--views stereo|cubemap]\n");
+		return -1;
+	}
+	int firstFrame = atoi(argv[2]);
+	int frameCount = atoi(argv[3]);
+	const char * outputPath = argv[4];
+
+	FILE * output = fopen(outputPath, "wb");
+	if (output == NULL) {
+		fprintf(stderr, "Worker couldn't open %s\n", outputPath);
+		return -1;
+	}
+
+	createOffscreenFramebuffer(width, height);
+	std::vector<unsigned char> pixels;
+
+	//The camera position is integrated from the start of the timeline, so catch it up to the first frame without drawing anything
+	float deltaTime = 1.0f / renderFramesPerSecond;
+	for (int frame = 0; frame < firstFrame; frame++) {
+		updateCameraPosition(findCameraRotation(), frame * deltaTime, deltaTime);
+	}
+
+	for (int frame = firstFrame; frame < firstFrame + frameCount; frame++) {
+		float timeSinceStart = frame * deltaTime;
+		updateCameraPosition(findCameraRotation(), timeSinceStart, deltaTime);
+		uploadFrameParams(evaluateFrame(timeSinceStart, findCameraRotation()));
+		int samples = 1;
+		if (progressiveEnabled) {
+			samples = renderProgressiveFrame();
+		}
+		else {
+			renderFrame();
+		}
+		fenceFrame();
+
+		if (viewCount > 1) {
+			readMultiViewPixels(pixels);
+		}
+		else if (denoiseEnabled) {
+			readDenoisedFramePixels(pixels);
+		}
+		else {
+			readFramePixels(width, height, pixels);
+		}
+		if (fwrite(&pixels[0], 1, pixels.size(), output) != pixels.size()) {
+			fprintf(stderr, "Worker failed writing frame %d\n", frame);
+			fclose(output);
+			return -1;
+		}
+
+		printf("FRAME %d (%d samples)\n", frame, samples);
+		fflush(stdout);
+	}
+
+	fclose(output);
+	printf("DONE\n");
+	fflush(stdout);
+	return 0;
+}
+
+//Makes an offscreen framebuffer and binds it for drawing.
+//The offline modes use this since a hidden window's own framebuffer isn't guaranteed to hold anything.
+GLuint createOffscreenFramebuffer(int targetWidth, int targetHeight) {
+	GLuint colorRenderbufferID;
+	glGenRenderbuffers(1, &colorRenderbufferID);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbufferID);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, targetWidth, targetHeight);
+
+	GLuint framebufferID;
+	glGenFramebuffers(1, &framebufferID);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbufferID);
+	glViewport(0, 0, targetWidth, targetHeight);
+
+	//Finished frames get presented here instead of the window from now on
+	outputFramebufferID = framebufferID;
+	return framebufferID;
+}
+
+//Reads back the bound framebuffer as 8 bit RGB, top row first.
+void readFramePixels(int targetWidth, int targetHeight, std::vector<unsigned char> & pixels) {
+	std::vector<unsigned char> bottomUpPixels(targetWidth * targetHeight * 3);
+	pixels.resize(targetWidth * targetHeight * 3);
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, targetWidth, targetHeight, GL_RGB, GL_UNSIGNED_BYTE, &bottomUpPixels[0]);
+
+	//OpenGL reads bottom row first, but image files and raw video expect the top row first
+	for (int row = 0; row < targetHeight; row++) {
+		memcpy(&pixels[row * targetWidth * 3], &bottomUpPixels[(targetHeight - 1 - row) * targetWidth * 3], targetWidth * 3);
+	}
+}
+
+//Reads every view back out of the layers of the color target, stacked top to bottom in view order, each top row first.
+void readMultiViewPixels(std::vector<unsigned char> & pixels) {
+	int layerSize = marcherTargetWidth * marcherTargetHeight * 3;
+	std::vector<unsigned char> bottomUpPixels(layerSize * viewCount);
+	pixels.resize(layerSize * viewCount);
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTextureImage(renderTargetTextureIDs[RENDER_TARGET_COLOR], 0, GL_RGB, GL_UNSIGNED_BYTE, (GLsizei)bottomUpPixels.size(), &bottomUpPixels[0]);
+
+	for (int view = 0; view < viewCount; view++) {
+		for (int row = 0; row < marcherTargetHeight; row++) {
+			memcpy(
+				&pixels[view * layerSize + row * marcherTargetWidth * 3],
+				&bottomUpPixels[view * layerSize + (marcherTargetHeight - 1 - row) * marcherTargetWidth * 3],
+				marcherTargetWidth * 3
+			);
+		}
+	}
+}
+
+//Reads the marcher's color, depth and normal targets back, denoises the color on the CPU, and converts it to 8 bit RGB, top row first.
+void readDenoisedFramePixels(std::vector<unsigned char> & pixels) {
+	int pixelCount = marcherTargetWidth * marcherTargetHeight;
+	std::vector<float> colors(pixelCount * 3);
+	std::vector<float> depths(pixelCount);
+	std::vector<float> encodedNormals(pixelCount * 2);
+	glGetTextureImage(renderTargetTextureIDs[RENDER_TARGET_COLOR], 0, GL_RGB, GL_FLOAT, (GLsizei)(colors.size() * sizeof(float)), &colors[0]);
+	glGetTextureImage(renderTargetTextureIDs[RENDER_TARGET_DEPTH], 0, GL_RED, GL_FLOAT, (GLsizei)(depths.size() * sizeof(float)), &depths[0]);
+	glGetTextureImage(renderTargetTextureIDs[RENDER_TARGET_NORMAL], 0, GL_RG, GL_FLOAT, (GLsizei)(encodedNormals.size() * sizeof(float)), &encodedNormals[0]);
+
+	//The denoiser wants every channel in its own plane, and its normals decoded
+	std::vector<float> red(pixelCount), green(pixelCount), blue(pixelCount);
+	std::vector<float> normalX(pixelCount), normalY(pixelCount), normalZ(pixelCount);
+	for (int i = 0; i < pixelCount; i++) {
+		red[i] = colors[i * 3];
+		green[i] = colors[i * 3 + 1];
+		blue[i] = colors[i * 3 + 2];
+
+		//Undoes octahedralEncode in Shading.glsl, like octahedralDecode does.
+		//The sky's normal is stored as (0, 0), but so is a surface facing straight down +z, so the sky is told apart by its depth and given a zero normal.
+		vec3 n = vec3(0, 0, 0);
+		if (depths[i] < camRayTooFar) {
+			vec2 e = vec2(encodedNormals[i * 2], encodedNormals[i * 2 + 1]);
+			n = vec3(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+			if (n.z < 0) {
+				n.x = (1.0f - fabsf(e.y)) * (e.x >= 0 ? 1.0f : -1.0f);
+				n.y = (1.0f - fabsf(e.x)) * (e.y >= 0 ? 1.0f : -1.0f);
+			}
+			n = normalize(n);
+		}
+		normalX[i] = n.x;
+		normalY[i] = n.y;
+		normalZ[i] = n.z;
+	}
+
+	DenoiserFrame frame;
+	frame.width = marcherTargetWidth;
+	frame.height = marcherTargetHeight;
+	frame.red = &red[0];
+	frame.green = &green[0];
+	frame.blue = &blue[0];
+	frame.depth = &depths[0];
+	frame.normalX = &normalX[0];
+	frame.normalY = &normalY[0];
+	frame.normalZ = &normalZ[0];
+	denoiseFrame(frame, defaultDenoiserSettings());
+
+	//Textures come back bottom row first too
+	pixels.resize(pixelCount * 3);
+	for (int row = 0; row < marcherTargetHeight; row++) {
+		for (int x = 0; x < marcherTargetWidth; x++) {
+			int source = (marcherTargetHeight - 1 - row) * marcherTargetWidth + x;
+			int destination = (row * marcherTargetWidth + x) * 3;
+			pixels[destination] = (unsigned char)(clamp(red[source], 0.0f, 1.0f) * 255.0f + 0.5f);
+			pixels[destination + 1] = (unsigned char)(clamp(green[source], 0.0f, 1.0f) * 255.0f + 0.5f);
+			pixels[destination + 2] = (unsigned char)(clamp(blue[source], 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+	}
+}
+
+#ifdef _WIN32
+#define openProcessPipe _popen
+#define closeProcessPipe _pclose
+#else
+#define openProcessPipe popen
+#define closeProcessPipe pclose
+#endif
+
+//How many bytes of raw RGB each rendered frame takes. With --views that's every view stacked top to bottom.
+long long renderedFrameBytes() {
+	return (long long)viewCount * viewWidth * viewHeight * 3;
+}
+
+//Returns the size of a file, or -1 if it can't be opened. Multi-view renders get well past 2GB, which plain ftell can't count to on Windows.
+long long fileBytes(const std::string & path) {
+	FILE * file = fopen(path.c_str(), "rb");
+	if (file == NULL) return -1;
+#ifdef _WIN32
+	_fseeki64(file, 0, SEEK_END);
+	long long bytes = _ftelli64(file);
+#else
+	fseeko(file, 0, SEEK_END);
+	long long bytes = ftello(file);
+#endif
+	fclose(file);
+	return bytes;
+}
+
+//Runs one worker process over a frame range, following its progress through its stdout pipe.
+//Returns true only if the worker said it finished and its output is exactly as big as it should be.
+//Anything on the coordinator's command line after the output path is passed on to the workers, e.g. --progressive.
+bool renderFrameRange(const char * executablePath, const FrameRange & range, const std::string & rangePath, const std::string & workerArguments) {
+	std::string command = "\"" + std::string(executablePath) + "\" --worker " +
+		std::to_string(range.firstFrame) + " " + std::to_string(range.frameCount) + " \"" + rangePath + "\"" +
+		" --fps " + std::to_string(renderFramesPerSecond) + workerArguments;
+#ifdef _WIN32
+	//cmd strips the outermost quotes, so wrap the whole thing in one more pair
+	command = "\"" + command + "\"";
+#endif
+
+	FILE * workerPipe = openProcessPipe(command.c_str(), "r");
+	if (workerPipe == NULL) return false;
+
+	bool sawDone = false;
+	char line[256];
+	while (fgets(line, sizeof(line), workerPipe) != NULL) {
+		if (strncmp(line, "DONE", 4) == 0) sawDone = true;
+	}
+	int exitCode = closeProcessPipe(workerPipe);
+
+	return exitCode == 0 && sawDone && fileBytes(rangePath) == range.frameCount * renderedFrameBytes();
+}
+
+//Splits the whole timeline into frame ranges, hands them out to worker processes, retries any that fail, then stitches the results together in order.
+//Usage: GravelMarcher --coordinator <workerCount> <outputPath> [--fps n] [--range-frames n] [worker options...]
+//The output is raw 8 bit RGB video, e.g. ffmpeg -f rawvideo -pix_fmt rgb24 -s 1920x1200 -r 60 -i show.rgb show.mp4
+//With --views, each frame is every view stacked top to bottom, so stereo is 1920x2400 over-under, and cubemap is 1200x7200,
+//which ffmpeg can turn into a 360 video with -vf v360=c1x6:e.
+int runCoordinator(int argc, char* argv[]) {
+	if (argc < 4) {
+		fprintf(stderr, "Usage: GravelMarcher --coordinator <workerCount> <outputPath> [--fps n] [--range-frames n] [worker options...]\n");
+		return -1;
+	}
+	int workerCount = std::max(atoi(argv[2]), 1);
+	std::string outputPath = argv[3];
+
+	//The workers get everything else on the command line. They already get --fps from the coordinator.
+	std::string workerArguments;
+	for (int i = 4; i < argc; i++) {
+		if (strcmp(argv[i], "--fps") == 0 || strcmp(argv[i], "--range-frames") == 0) {
+			i++;
+			continue;
+		}
+		workerArguments += " \"" + std::string(argv[i]) + "\"";
+	}
+
+	int totalFrames = (int)ceil(findTimelineLength() * renderFramesPerSecond) + 1;
+
+	//Splits the timeline into ranges. Each one gets its own file so the workers never have to share anything.
+	std::vector<FrameRange> ranges;
+	for (int firstFrame = 0; firstFrame < totalFrames; firstFrame += renderRangeFrames) {
+		FrameRange range;
+		range.firstFrame = firstFrame;
+		range.frameCount = std::min(renderRangeFrames, totalFrames - firstFrame);
+		range.attempts = 0;
+		ranges.push_back(range);
+	}
+
+	std::deque<int> pendingRanges;
+	for (int i = 0; i < (int)ranges.size(); i++) pendingRanges.push_back(i);
+	std::mutex rangesMutex;
+	int rangesDone = 0;
+	bool renderFailed = false;
+
+	printf("Rendering %d frames in %d ranges across %d workers\n", totalFrames, (int)ranges.size(), workerCount);
+
+	//Each thread babysits one worker process at a time, pulling ranges off the queue until it's empty
+	std::vector<std::thread> workerThreads;
+	for (int w = 0; w < workerCount; w++) {
+		workerThreads.push_back(std::thread([&]() {
+			while (true) {
+				int rangeIndex;
+				{
+					std::lock_guard<std::mutex> lock(rangesMutex);
+					if (pendingRanges.empty() || renderFailed) return;
+					rangeIndex = pendingRanges.front();
+					pendingRanges.pop_front();
+					ranges[rangeIndex].attempts++;
+				}
+
+				std::string rangePath = outputPath + ".part" + std::to_string(rangeIndex);
+				bool succeeded = renderFrameRange(argv[0], ranges[rangeIndex], rangePath, workerArguments);
+
+				std::lock_guard<std::mutex> lock(rangesMutex);
+				if (succeeded) {
+					rangesDone++;
+					printf("Frames %d-%d done (%d/%d ranges)\n", ranges[rangeIndex].firstFrame, ranges[rangeIndex].firstFrame + ranges[rangeIndex].frameCount - 1, rangesDone, (int)ranges.size());
+				}
+				else if (ranges[rangeIndex].attempts < renderRangeMaxAttempts) {
+					printf("Frames %d-%d failed, retrying\n", ranges[rangeIndex].firstFrame, ranges[rangeIndex].firstFrame + ranges[rangeIndex].frameCount - 1);
+					pendingRanges.push_back(rangeIndex);
+				}
+				else {
+					fprintf(stderr, "Frames %d-%d failed %d times, giving up\n", ranges[rangeIndex].firstFrame, ranges[rangeIndex].firstFrame + ranges[rangeIndex].frameCount - 1, renderRangeMaxAttempts);
+					renderFailed = true;
+				}
+				fflush(stdout);
+			}
+		}));
+	}
+	for (std::thread & workerThread : workerThreads) workerThread.join();
+
+	//Nothing's left half written when the coordinator gives up: not the ranges, and not the stitched output
+	auto removeRangeFiles = [&]() {
+		for (int i = 0; i < (int)ranges.size(); i++) {
+			remove((outputPath + ".part" + std::to_string(i)).c_str());
+		}
+	};
+	if (renderFailed) {
+		removeRangeFiles();
+		return -1;
+	}
+
+	//Stitches the ranges together in timeline order
+	FILE * output = fopen(outputPath.c_str(), "wb");
+	if (output == NULL) {
+		fprintf(stderr, "Coordinator couldn't open %s\n", outputPath.c_str());
+		removeRangeFiles();
+		return -1;
+	}
+	std::vector<char> copyBuffer(1 << 20);
+	bool stitchFailed = false;
+	for (int i = 0; i < (int)ranges.size() && !stitchFailed; i++) {
+		std::string rangePath = outputPath + ".part" + std::to_string(i);
+		FILE * rangeFile = fopen(rangePath.c_str(), "rb");
+		if (rangeFile == NULL) {
+			fprintf(stderr, "Coordinator lost %s\n", rangePath.c_str());
+			stitchFailed = true;
+			break;
+		}
+		size_t bytesRead;
+		while ((bytesRead = fread(&copyBuffer[0], 1, copyBuffer.size(), rangeFile)) > 0) {
+			if (fwrite(&copyBuffer[0], 1, bytesRead, output) != bytesRead) {
+				fprintf(stderr, "Coordinator failed writing %s\n", outputPath.c_str());
+				stitchFailed = true;
+				break;
+			}
+		}
+		if (!stitchFailed && ferror(rangeFile)) {
+			fprintf(stderr, "Coordinator failed reading %s\n", rangePath.c_str());
+			stitchFailed = true;
+		}
+		fclose(rangeFile);
+	}
+	if (fclose(output) != 0 && !stitchFailed) {
+		fprintf(stderr, "Coordinator failed writing %s\n", outputPath.c_str());
+		stitchFailed = true;
+	}
+	removeRangeFiles();
+
+	//Every range was checked on its own, but a range that went missing or got stitched twice would only show up here
+	if (!stitchFailed) {
+		long long stitchedBytes = fileBytes(outputPath);
+		if (stitchedBytes != totalFrames * renderedFrameBytes()) {
+			fprintf(stderr, "Coordinator stitched %lld bytes into %s, expected %lld\n", stitchedBytes, outputPath.c_str(), totalFrames * renderedFrameBytes());
+			stitchFailed = true;
+		}
+	}
+	if (stitchFailed) {
+		remove(outputPath.c_str());
+		return -1;
+	}
+
+	printf("Wrote %s\n", outputPath.c_str());
+	return 0;
+}
+
 void cursorPosCallback(GLFWwindow* window, double xpos, double ypos) {
 	double deltaX = xpos - oldMouseXPos;
 	cameraYaw += deltaX * cameraRotSpeed;
@@ -514,6 +2275,44 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 		}
 	}
 
+	//The C key toggles checkerboard rendering
+	if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+		checkerboardEnabled = !checkerboardEnabled;
+		if (checkerboardEnabled) variableRateEnabled = wavefrontEnabled = false;
+	}
+
+	//The V key toggles variable-rate marching
+	if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+		variableRateEnabled = !variableRateEnabled;
+		if (variableRateEnabled) checkerboardEnabled = wavefrontEnabled = false;
+	}
+
+	//The L key toggles the point lights
+	if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+		pointLightsEnabled = !pointLightsEnabled;
+	}
+
+	//The R key toggles wavefront marching
+	if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+		wavefrontEnabled = !wavefrontEnabled;
+		if (wavefrontEnabled) checkerboardEnabled = variableRateEnabled = false;
+	}
+
+	//The O key toggles ambient occlusion
+	if (key == GLFW_KEY_O && action == GLFW_PRESS) {
+		ssaoEnabled = !ssaoEnabled;
+	}
+
+	//The T key toggles tile culling
+	if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+		tileCullEnabled = !tileCullEnabled;
+	}
+
+	//The M key toggles the rate map debug view
+	if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+		variableRateDebugView = !variableRateDebugView;
+	}
+
 	//The Space key
 	if (key == GLFW_KEY_SPACE) {
 		if (action == GLFW_PRESS) {
@@ -541,10 +2340,16 @@ GLuint bufferVertexData(T data[], unsigned int dataSize) {
 #include <vector>
 
 GLuint loadShaderProgram(const char * vertex_file_path, const char * fragment_file_path) {
+	steady_clock::time_point buildStart = steady_clock::now();
 
 	// Create the shaders
 	GLuint VertexShaderID = compileShader(vertex_file_path, GL_VERTEX_SHADER);
 	GLuint FragmentShaderID = compileShader(fragment_file_path, GL_FRAGMENT_SHADER);
+	if (VertexShaderID == 0 || FragmentShaderID == 0) {
+		glDeleteShader(VertexShaderID);
+		glDeleteShader(FragmentShaderID);
+		return 0;
+	}
 
 	// Link the program
 	printf("Linking program\n");
@@ -571,9 +2376,53 @@ GLuint loadShaderProgram(const char * vertex_file_path, const char * fragment_fi
 	glDeleteShader(VertexShaderID);
 	glDeleteShader(FragmentShaderID);
 
+	//Returns 0 for a program that didn't link, so it never gets used
+	if (Result != GL_TRUE) {
+		glDeleteProgram(ProgramID);
+		return 0;
+	}
+
+	recordShaderBuild(duration<double>(steady_clock::now() - buildStart).count());
 	return ProgramID;
 }
 
+//GLSL has no #include of its own, so lines starting with #include "SomeFile.glsl" are swapped for that file's contents here.
+//Included files can include other files too. SceneDistance.glsl isn't a file, but the scene's distance, written out from SdfKernels.h.
+bool expandShaderIncludes(std::string & shaderCode) {
+	size_t includeIndex = 0;
+	while ((includeIndex = shaderCode.find("#include \"", includeIndex)) != std::string::npos) {
+		//Only counts at the start of a line, so comments can talk about includes
+		if (includeIndex > 0 && shaderCode[includeIndex - 1] != '\n') {
+			includeIndex++;
+			continue;
+		}
+		size_t pathStart = includeIndex + strlen("#include \"");
+		size_t pathEnd = shaderCode.find('"', pathStart);
+		size_t lineEnd = shaderCode.find('\n', pathStart);
+
+		//The closing quote has to be on the same line, or there's no telling where the path ends
+		if (pathEnd == std::string::npos || (lineEnd != std::string::npos && pathEnd > lineEnd)) {
+			printf("Shader include has no closing quote: %s\n", shaderCode.substr(includeIndex, lineEnd == std::string::npos ? std::string::npos : lineEnd - includeIndex).c_str());
+			return false;
+		}
+		std::string includePath = shaderCode.substr(pathStart, pathEnd - pathStart);
+		if (includePath == "SceneDistance.glsl") {
+			shaderCode.replace(includeIndex, pathEnd + 1 - includeIndex, gravelSceneDistanceGLSL());
+			continue;
+		}
+
+		std::ifstream includeStream(includePath, std::ios::in);
+		if (!includeStream.is_open()) {
+			printf("Impossible to open %s. Remember the path origin is the same folder as the EXE!\n", includePath.c_str());
+			return false;
+		}
+		std::stringstream sstr;
+		sstr << includeStream.rdbuf();
+		shaderCode.replace(includeIndex, pathEnd + 1 - includeIndex, sstr.str());
+	}
+	return true;
+}
+
 GLuint compileShader(const char * shaderPath, GLenum shaderType) {
 	GLuint shaderID = glCreateShader(shaderType);
 	// Read the Vertex Shader code from the file
@@ -586,8 +2435,14 @@ GLuint compileShader(const char * shaderPath, GLenum shaderType) {
 		shaderStream.close();
 	}
 	else {
-		printf("Impossible to open %s. Remember the path origin is the same folder as the EXE!", shaderPath);
-		getchar();
+		printf("Impossible to open %s. Remember the path origin is the same folder as the EXE!\n", shaderPath);
+		glDeleteShader(shaderID);
+		return 0;
+	}
+
+	//Pastes in anything the shader #includes
+	if (!expandShaderIncludes(shaderCode)) {
+		glDeleteShader(shaderID);
 		return 0;
 	}
 
@@ -609,11 +2464,19 @@ GLuint compileShader(const char * shaderPath, GLenum shaderType) {
 		printf("%s\n", &VertexShaderErrorMessage[0]);
 	}
 
+	//Whoever asked for the shader decides what to do about it not compiling
+	if (Result != GL_TRUE) {
+		glDeleteShader(shaderID);
+		return 0;
+	}
+
 	return shaderID;
 }
 
 GLuint loadComputeShaderProgram(const char * computeFilePath) {
+	steady_clock::time_point buildStart = steady_clock::now();
 	GLuint computeShaderID = compileShader(computeFilePath, GL_COMPUTE_SHADER);
+	if (computeShaderID == 0) return 0;
 
 	GLuint programID = glCreateProgram();
 	glAttachShader(programID, computeShaderID);
@@ -633,5 +2496,373 @@ GLuint loadComputeShaderProgram(const char * computeFilePath) {
 	glDetachShader(programID, computeShaderID);
 	glDeleteShader(computeShaderID);
 
+	if (result != GL_TRUE) {
+		glDeleteProgram(programID);
+		return 0;
+	}
+
+	recordShaderBuild(duration<double>(steady_clock::now() - buildStart).count());
 	return programID;
-}
\ No newline at end of file
+}
+
+//--------------------------------------Shader hot reloading-------------------------------------
+
+//Whether any of a program's source files is in the list of changed files.
+bool usesChangedFile(const ReloadableProgram & program, const std::vector<std::string> & changedFiles) {
+	for (const std::string & changedFile : changedFiles) {
+		if (program.vertexPath != NULL && changedFile == program.vertexPath) return true;
+		if (program.fragmentPath != NULL && changedFile == program.fragmentPath) return true;
+		if (program.computePath != NULL && changedFile == program.computePath) return true;
+		for (int i = 0; i < sharedShaderFileCount; i++) {
+			if (changedFile == sharedShaderFiles[i]) return true;
+		}
+	}
+	return false;
+}
+
+//Rebuilds a program on the reloader's context and leaves it pending for the main thread to swap in.
+void rebuildProgram(ReloadableProgram & program) {
+	GLuint newProgramID = program.computePath != NULL ?
+		loadComputeShaderProgram(program.computePath) :
+		loadShaderProgram(program.vertexPath, program.fragmentPath);
+	if (newProgramID == 0) {
+		printf("Reload failed, keeping the old %s\n", program.computePath != NULL ? program.computePath : program.fragmentPath);
+		return;
+	}
+
+	//The fence has to be flushed, otherwise the main thread could wait on it forever
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+
+	std::lock_guard<std::mutex> lock(shaderReloaderMutex);
+	//A program that was never swapped in has already been overtaken by this one
+	if (program.pendingProgramID != 0) {
+		glDeleteProgram(program.pendingProgramID);
+		glDeleteSync(program.pendingFence);
+	}
+	program.pendingProgramID = newProgramID;
+	program.pendingFence = fence;
+}
+
+#ifdef __linux__
+//Waits up to shaderReloaderPollInterval for files in the working directory to be written, and returns their names.
+//Editors often save by writing a new file and moving it over the old one, so moves count too.
+std::vector<std::string> waitForChangedFiles(int inotifyFD) {
+	std::vector<std::string> changedFiles;
+	pollfd pollInfo = { inotifyFD, POLLIN, 0 };
+	if (poll(&pollInfo, 1, shaderReloaderPollInterval) <= 0) return changedFiles;
+
+	alignas(inotify_event) char eventBuffer[4096];
+	ssize_t bytesRead;
+	while ((bytesRead = read(inotifyFD, eventBuffer, sizeof(eventBuffer))) > 0) {
+		for (char * eventPointer = eventBuffer; eventPointer < eventBuffer + bytesRead;) {
+			inotify_event * event = (inotify_event *)eventPointer;
+			if (event->len > 0) changedFiles.push_back(event->name);
+			eventPointer += sizeof(inotify_event) + event->len;
+		}
+	}
+	return changedFiles;
+}
+#else
+//Checks each shader file's modification time every shaderReloaderPollInterval, and returns the ones that changed.
+std::vector<std::string> waitForChangedFiles(std::vector<std::pair<std::string, time_t>> & modificationTimes) {
+	std::this_thread::sleep_for(std::chrono::milliseconds(shaderReloaderPollInterval));
+	std::vector<std::string> changedFiles;
+	for (std::pair<std::string, time_t> & file : modificationTimes) {
+		struct stat fileInfo;
+		if (stat(file.first.c_str(), &fileInfo) == 0 && fileInfo.st_mtime != file.second) {
+			file.second = fileInfo.st_mtime;
+			changedFiles.push_back(file.first);
+		}
+	}
+	return changedFiles;
+}
+#endif
+
+void startShaderReloader() {
+	//GLFW windows can only be made on the main thread, so the reloader's context is made here and handed over
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	shaderReloaderWindow = glfwCreateWindow(1, 1, "GravelMarcher shader reloader", NULL, window);
+	if (shaderReloaderWindow == NULL) {
+		fprintf(stderr, "Couldn't make a context for reloading shaders, so they won't be\n");
+		return;
+	}
+
+	shaderReloaderThread = std::thread([]() {
+		glfwMakeContextCurrent(shaderReloaderWindow);
+
+#ifdef __linux__
+		int inotifyFD = inotify_init1(IN_NONBLOCK);
+		inotify_add_watch(inotifyFD, ".", IN_CLOSE_WRITE | IN_MOVED_TO);
+#else
+		std::vector<std::pair<std::string, time_t>> modificationTimes;
+		for (int i = 0; i < reloadableProgramCount; i++) {
+			const char * paths[] = { reloadablePrograms[i].vertexPath, reloadablePrograms[i].fragmentPath, reloadablePrograms[i].computePath };
+			for (const char * path : paths) {
+				struct stat fileInfo;
+				if (path != NULL && stat(path, &fileInfo) == 0) modificationTimes.push_back(std::make_pair(std::string(path), fileInfo.st_mtime));
+			}
+		}
+		for (int i = 0; i < sharedShaderFileCount; i++) {
+			struct stat fileInfo;
+			if (stat(sharedShaderFiles[i], &fileInfo) == 0) modificationTimes.push_back(std::make_pair(std::string(sharedShaderFiles[i]), fileInfo.st_mtime));
+		}
+#endif
+
+		while (!shaderReloaderQuitting) {
+#ifdef __linux__
+			std::vector<std::string> changedFiles = waitForChangedFiles(inotifyFD);
+#else
+			std::vector<std::string> changedFiles = waitForChangedFiles(modificationTimes);
+#endif
+			for (int i = 0; i < reloadableProgramCount; i++) {
+				if (usesChangedFile(reloadablePrograms[i], changedFiles)) rebuildProgram(reloadablePrograms[i]);
+			}
+		}
+
+#ifdef __linux__
+		close(inotifyFD);
+#endif
+		glfwMakeContextCurrent(NULL);
+	});
+}
+
+//Swaps in any rebuilt programs the GPU has finished with. Anything not ready yet just waits for the next frame.
+void applyReloadedShaders() {
+	std::lock_guard<std::mutex> lock(shaderReloaderMutex);
+	for (int i = 0; i < reloadableProgramCount; i++) {
+		ReloadableProgram & program = reloadablePrograms[i];
+		if (program.pendingProgramID == 0) continue;
+		if (glClientWaitSync(program.pendingFence, 0, 0) == GL_TIMEOUT_EXPIRED) continue;
+
+		glDeleteSync(program.pendingFence);
+		glDeleteProgram(*program.programID);
+		*program.programID = program.pendingProgramID;
+		program.pendingProgramID = 0;
+		program.pendingFence = 0;
+
+		if (program.programID == &marcherProgramID) findUniformHandles(marcherProgramID);
+		if (program.programID == &skyLUTProgramID) skyLUTIsValid = false;
+		printf("Reloaded %s\n", program.computePath != NULL ? program.computePath : program.fragmentPath);
+	}
+}
+
+void stopShaderReloader() {
+	if (shaderReloaderWindow == NULL) return;
+	shaderReloaderQuitting = true;
+	shaderReloaderThread.join();
+	glfwDestroyWindow(shaderReloaderWindow);
+}
+
+//------------------------------------------Benchmarking-----------------------------------------
+
+bool writePPM(const std::string & path, int imageWidth, int imageHeight, const std::vector<unsigned char> & pixels) {
+	FILE * file = fopen(path.c_str(), "wb");
+	if (file == NULL) return false;
+	fprintf(file, "P6\n%d %d\n255\n", imageWidth, imageHeight);
+	fwrite(&pixels[0], 1, pixels.size(), file);
+	fclose(file);
+	return true;
+}
+
+//Only reads the binary, 8 bit flavor of PPM, which is all writePPM makes.
+bool readPPM(const std::string & path, int & imageWidth, int & imageHeight, std::vector<unsigned char> & pixels) {
+	FILE * file = fopen(path.c_str(), "rb");
+	if (file == NULL) return false;
+	int maxValue;
+	if (fscanf(file, "P6 %d %d %d", &imageWidth, &imageHeight, &maxValue) != 3 || maxValue != 255) {
+		fclose(file);
+		return false;
+	}
+	fgetc(file);
+	pixels.resize(imageWidth * imageHeight * 3);
+	bool complete = fread(&pixels[0], 1, pixels.size(), file) == pixels.size();
+	fclose(file);
+	return complete;
+}
+
+//Peak signal to noise ratio between two equally sized 8 bit images, in decibels. Identical images come out as infinity.
+double findPSNR(const std::vector<unsigned char> & a, const std::vector<unsigned char> & b) {
+	double squaredErrorSum = 0;
+	for (size_t i = 0; i < a.size(); i++) {
+		double difference = double(a[i]) - double(b[i]);
+		squaredErrorSum += difference * difference;
+	}
+	double meanSquaredError = squaredErrorSum / a.size();
+	if (meanSquaredError == 0) return INFINITY;
+	return 10.0 * log10(255.0 * 255.0 / meanSquaredError);
+}
+
+//Structural similarity between two equally sized 8 bit images, averaged over 8x8 windows of luminance. 1 means identical.
+double findSSIM(const std::vector<unsigned char> & a, const std::vector<unsigned char> & b, int imageWidth, int imageHeight) {
+	const int windowSize = 8;
+	const double c1 = (0.01 * 255) * (0.01 * 255);
+	const double c2 = (0.03 * 255) * (0.03 * 255);
+
+	double ssimSum = 0;
+	int windowCount = 0;
+	for (int windowY = 0; windowY + windowSize <= imageHeight; windowY += windowSize) {
+		for (int windowX = 0; windowX + windowSize <= imageWidth; windowX += windowSize) {
+			double sumA = 0, sumB = 0, sumAA = 0, sumBB = 0, sumAB = 0;
+			for (int y = windowY; y < windowY + windowSize; y++) {
+				for (int x = windowX; x < windowX + windowSize; x++) {
+					int i = (y * imageWidth + x) * 3;
+					double lumaA = 0.299 * a[i] + 0.587 * a[i + 1] + 0.114 * a[i + 2];
+					double lumaB = 0.299 * b[i] + 0.587 * b[i + 1] + 0.114 * b[i + 2];
+					sumA += lumaA;
+					sumB += lumaB;
+					sumAA += lumaA * lumaA;
+					sumBB += lumaB * lumaB;
+					sumAB += lumaA * lumaB;
+				}
+			}
+			double n = windowSize * windowSize;
+			double meanA = sumA / n;
+			double meanB = sumB / n;
+			double varianceA = sumAA / n - meanA * meanA;
+			double varianceB = sumBB / n - meanB * meanB;
+			double covariance = sumAB / n - meanA * meanB;
+			ssimSum += ((2 * meanA * meanB + c1) * (2 * covariance + c2)) / ((meanA * meanA + meanB * meanB + c1) * (varianceA + varianceB + c2));
+			windowCount++;
+		}
+	}
+	return ssimSum / windowCount;
+}
+
+//Times the current frame a few times over and returns the median in milliseconds, to shrug off the odd hiccup
+double timeBenchmarkFrame(GLuint timerQueryID) {
+	std::vector<double> frameTimes;
+	for (int repeat = 0; repeat < benchmarkRepeats; repeat++) {
+		glBeginQuery(GL_TIME_ELAPSED, timerQueryID);
+		renderFrame();
+		glEndQuery(GL_TIME_ELAPSED);
+		GLuint64 elapsedNanoseconds;
+		glGetQueryObjectui64v(timerQueryID, GL_QUERY_RESULT, &elapsedNanoseconds);
+		frameTimes.push_back(elapsedNanoseconds / 1.0e6);
+	}
+	std::sort(frameTimes.begin(), frameTimes.end());
+	return frameTimes[benchmarkRepeats / 2];
+}
+
+//Renders each benchmark shot, then checks its frame time and march steps against the baseline and its image against the golden one.
+//Usage: GravelMarcher --benchmark [--update-golden] [--wavefront] [--software-gl]
+//Rays per second counts camera and shadow rays. With --wavefront, the fragment marcher is timed too, for the speedup over it.
+//--update-golden rewrites the golden images and baseline from this run instead of checking against them.
+//Frame times only mean something on the machine that made the baseline, so each box should keep its own.
+//Returns 0 if every shot passed, 1 if anything regressed.
+int runBenchmark(int argc, char* argv[]) {
+	bool updateGolden = false;
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "--update-golden") == 0) updateGolden = true;
+	}
+
+	printf("Benchmarking on %s\n", (const char *)glGetString(GL_RENDERER));
+
+	createOffscreenFramebuffer(benchmarkWidth, benchmarkHeight);
+
+	//Reads the baseline numbers, one "name frameTimeMs averageSteps" line per shot
+	std::vector<std::string> baselineNames;
+	std::vector<double> baselineFrameTimes;
+	std::vector<double> baselineSteps;
+	if (!updateGolden) {
+		std::ifstream baselineStream(benchmarkBaselinePath);
+		std::string name;
+		double frameTime, steps;
+		while (baselineStream >> name >> frameTime >> steps) {
+			baselineNames.push_back(name);
+			baselineFrameTimes.push_back(frameTime);
+			baselineSteps.push_back(steps);
+		}
+	}
+	std::ofstream newBaselineStream;
+	if (updateGolden) newBaselineStream.open(benchmarkBaselinePath);
+
+	GLuint timerQueryID;
+	glGenQueries(1, &timerQueryID);
+
+	bool anyFailed = false;
+	int frame = 0;
+	float deltaTime = 1.0f / renderFramesPerSecond;
+
+	printf("%-20s %10s %10s %10s %10s %8s %10s %8s %s\n", "shot", "time (ms)", "avg steps", "max steps", "Mrays/s", "vs frag", "PSNR (dB)", "SSIM", "result");
+	for (int shot = 0; shot < benchmarkShotCount; shot++) {
+		//Integrates the camera up to the shot, exactly like an offline render would
+		int shotFrame = (int)round(benchmarkShots[shot].time * renderFramesPerSecond);
+		for (; frame <= shotFrame; frame++) {
+			updateCameraPosition(findCameraRotation(), frame * deltaTime, deltaTime);
+		}
+		uploadFrameParams(evaluateFrame(benchmarkShots[shot].time, findCameraRotation()));
+
+		double frameTime = timeBenchmarkFrame(timerQueryID);
+
+		//In wavefront mode, the fragment marcher does the same shot for comparison
+		bool wavefrontShot = currentFrameParams.wavefrontEnabled != 0;
+		double fragmentFrameTime = frameTime;
+		if (wavefrontShot) {
+			currentFrameParams.wavefrontEnabled = 0;
+			fragmentFrameTime = timeBenchmarkFrame(timerQueryID);
+			currentFrameParams.wavefrontEnabled = 1;
+		}
+
+		//One more pass with the statistics on, in the mode being benchmarked, so the rays counted are the ones that were timed.
+		//It's kept apart from the timed passes since the atomics slow things down. Its image is also the one that gets checked.
+		GLuint zeroStats[MARCH_STATS_COUNT] = { 0 };
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, marchStatsBufferID);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zeroStats), zeroStats);
+		setCollectMarchStats(true);
+		renderFrame();
+		setCollectMarchStats(false);
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		GLuint marchStats[MARCH_STATS_COUNT];
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(marchStats), marchStats);
+		double averageSteps = double(marchStats[MARCH_STATS_STEPS_TOTAL]) / (benchmarkWidth * benchmarkHeight);
+		double raysPerSecond = double(marchStats[MARCH_STATS_MARCHED_PIXELS] + marchStats[MARCH_STATS_SHADOW_RAYS]) / (frameTime / 1000);
+		char speedup[16] = "-";
+		if (wavefrontShot) snprintf(speedup, sizeof(speedup), "%.2fx", fragmentFrameTime / frameTime);
+
+		std::vector<unsigned char> pixels;
+		readFramePixels(benchmarkWidth, benchmarkHeight, pixels);
+		std::string goldenPath = std::string(benchmarkGoldenPrefix) + benchmarkShots[shot].name + ".ppm";
+
+		if (updateGolden) {
+			writePPM(goldenPath, benchmarkWidth, benchmarkHeight, pixels);
+			newBaselineStream << benchmarkShots[shot].name << " " << frameTime << " " << averageSteps << "\n";
+			printf("%-20s %10.3f %10.2f %10u %10.1f %8s %10s %8s %s\n", benchmarkShots[shot].name, frameTime, averageSteps, marchStats[MARCH_STATS_STEPS_MAX],
+				raysPerSecond / 1.0e6, speedup, "-", "-", "updated");
+			continue;
+		}
+
+		//Compares against the golden image and baseline
+		std::string failure;
+		double psnr = 0, ssim = 0;
+		int goldenWidth, goldenHeight;
+		std::vector<unsigned char> goldenPixels;
+		if (!readPPM(goldenPath, goldenWidth, goldenHeight, goldenPixels) || goldenWidth != benchmarkWidth || goldenHeight != benchmarkHeight) {
+			failure = "no golden image";
+		}
+		else {
+			psnr = findPSNR(pixels, goldenPixels);
+			ssim = findSSIM(pixels, goldenPixels, benchmarkWidth, benchmarkHeight);
+			if (psnr < benchmarkMinPSNR) failure = "PSNR";
+			else if (ssim < benchmarkMinSSIM) failure = "SSIM";
+		}
+
+		int baselineIndex = (int)(std::find(baselineNames.begin(), baselineNames.end(), benchmarkShots[shot].name) - baselineNames.begin());
+		if (failure.empty()) {
+			if (baselineIndex == (int)baselineNames.size()) failure = "no baseline";
+			else if (frameTime > baselineFrameTimes[baselineIndex] * (1 + benchmarkMaxFrameTimeRegression)) failure = "frame time";
+			else if (averageSteps > baselineSteps[baselineIndex] * (1 + benchmarkMaxStepsRegression)) failure = "march steps";
+		}
+
+		if (!failure.empty()) {
+			anyFailed = true;
+			//Keeps what was actually rendered around, so it can be eyeballed next to the golden image
+			writePPM(std::string("benchmark_failed_") + benchmarkShots[shot].name + ".ppm", benchmarkWidth, benchmarkHeight, pixels);
+		}
+		printf("%-20s %10.3f %10.2f %10u %10.1f %8s %10.2f %8.4f %s\n", benchmarkShots[shot].name, frameTime, averageSteps, marchStats[MARCH_STATS_STEPS_MAX],
+			raysPerSecond / 1.0e6, speedup, psnr, ssim, failure.empty() ? "ok" : ("FAILED: " + failure).c_str());
+	}
+
+	glDeleteQueries(1, &timerQueryID);
+	return anyFailed ? 1 : 0;
+}
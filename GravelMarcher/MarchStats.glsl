@@ -0,0 +1,32 @@
+//-----------------------------March statistics------------------------------------------
+//The march statistics every marching path sums into, so the stats server and the benchmark see the same numbers whichever one drew the frame.
+//Has to come after Scene.glsl. Main.cpp's MARCH_STATS_* defines have to match.
+
+//When set, every ray adds its march to the statistics below. Off normally, since all those atomics aren't free.
+uniform bool collectMarchStats;
+
+//Totals over every pixel of the frame. The CPU zeroes these before the frame and reads them back after.
+layout(std430, binding = 0) buffer MarchStats {
+	uint marchStepsTotal;
+	uint marchStepsMax;
+	uint marchMaxItersPixels;
+
+	//How many pixels in progressive mode still hadn't converged, and so took another sample.
+	uint progressiveActivePixels;
+
+	//How many pixels marched a camera ray, which in checkerboard and variable-rate modes is fewer than are on screen.
+	uint marchedPixels;
+
+	//How many shadow rays were marched. With marchedPixels, that's every ray the frame took, for working out rays per second.
+	uint marchShadowRays;
+};
+
+//Adds a camera ray that took steps steps and stopped because of stopMode.
+void countCameraRay(uint steps, uint stopMode) {
+	atomicAdd(marchStepsTotal, steps);
+	atomicMax(marchStepsMax, steps);
+	atomicAdd(marchedPixels, 1u);
+	if(stopMode == STOP_MODE_MAX_ITERS) {
+		atomicAdd(marchMaxItersPixels, 1u);
+	}
+}
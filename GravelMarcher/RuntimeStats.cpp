@@ -0,0 +1,303 @@
+#include "RuntimeStats.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#else
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+//Windows has AF_UNIX too, since Windows 10, just behind Winsock's names
+#ifdef _WIN32
+typedef SOCKET StatsSocket;
+const StatsSocket invalidStatsSocket = INVALID_SOCKET;
+#define pollStatsSockets WSAPoll
+#define closeStatsSocket closesocket
+#else
+typedef int StatsSocket;
+const StatsSocket invalidStatsSocket = -1;
+#define pollStatsSockets poll
+#define closeStatsSocket close
+#endif
+
+//Winsock marks an AF_UNIX socket's file with this reparse tag. Older SDKs don't define it.
+#if defined(_WIN32) && !defined(IO_REPARSE_TAG_AF_UNIX)
+#define IO_REPARSE_TAG_AF_UNIX 0x80000023
+#endif
+
+//A scraper that hangs up early shouldn't take the whole process down with SIGPIPE
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+//-------------------------------------Counters------------------------------------------
+//Written by whatever thread is doing the work, read by the stats server. Nothing here is ever locked.
+
+//The render loop is the only writer, so a frame's time goes in its slot before framesTotal moves past it.
+//The server may read a slot just as it's overwritten, which only means it sees a frame that's slightly newer.
+std::atomic<uint32_t> recentFrameMicroseconds[RUNTIME_STATS_FRAME_HISTORY];
+std::atomic<uint64_t> framesTotal(0);
+std::atomic<uint64_t> frameMicrosecondsTotal(0);
+
+//The march statistics only mean anything together, so they're guarded by a sequence number that's odd while they're being written.
+//The server retries if it was odd, or changed while it read them. 0 means nothing has been recorded yet.
+std::atomic<uint32_t> marchStatsSequence(0);
+std::atomic<uint64_t> marchStepsTotal(0);
+std::atomic<uint32_t> marchStepsMax(0);
+std::atomic<uint64_t> marchMaxItersPixels(0);
+std::atomic<uint64_t> marchedPixels(0);
+
+std::atomic<uint64_t> shaderBuildsTotal(0);
+std::atomic<uint64_t> shaderBuildMicrosecondsTotal(0);
+std::atomic<uint32_t> lastShaderBuildMicroseconds(0);
+
+std::atomic<uint64_t> animationEvaluationsTotal(0);
+std::atomic<uint64_t> animationMicrosecondsTotal(0);
+
+//-----------------------------------Stats server----------------------------------------
+
+StatsSocket statsListenSocket = invalidStatsSocket;
+std::string statsServerSocketPath;
+std::thread statsServerThread;
+std::atomic<bool> statsServerQuitting(false);
+
+//How often, in milliseconds, the counters are sampled into a fresh exposition. Scrapes in between get the last one.
+const int statsSamplePeriod = 1000;
+
+//How often, in milliseconds, the server stops waiting for clients to check whether it should sample or quit.
+const int statsServerPollInterval = 250;
+
+//How long, in milliseconds, a client gets to send its request before it's answered anyway.
+//Plain socket clients like socat send nothing, so the server can't wait on them forever.
+const int statsRequestTimeout = 100;
+
+uint32_t toMicroseconds(double seconds) {
+	return (uint32_t)std::min(std::max(seconds * 1e6, 0.0), 4.0e9);
+}
+
+void recordFrameTime(double seconds) {
+	uint32_t microseconds = toMicroseconds(seconds);
+	uint64_t frame = framesTotal.load(std::memory_order_relaxed);
+	recentFrameMicroseconds[frame % RUNTIME_STATS_FRAME_HISTORY].store(microseconds, std::memory_order_relaxed);
+	frameMicrosecondsTotal.fetch_add(microseconds, std::memory_order_relaxed);
+	framesTotal.store(frame + 1, std::memory_order_release);
+}
+
+void recordMarchStats(uint64_t stepsTotal, uint32_t stepsMax, uint64_t maxItersPixels, uint64_t pixels) {
+	uint32_t sequence = marchStatsSequence.load(std::memory_order_relaxed);
+	marchStatsSequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	marchStepsTotal.store(stepsTotal, std::memory_order_relaxed);
+	marchStepsMax.store(stepsMax, std::memory_order_relaxed);
+	marchMaxItersPixels.store(maxItersPixels, std::memory_order_relaxed);
+	marchedPixels.store(pixels, std::memory_order_relaxed);
+	marchStatsSequence.store(sequence + 2, std::memory_order_release);
+}
+
+void recordShaderBuild(double seconds) {
+	uint32_t microseconds = toMicroseconds(seconds);
+	shaderBuildsTotal.fetch_add(1, std::memory_order_relaxed);
+	shaderBuildMicrosecondsTotal.fetch_add(microseconds, std::memory_order_relaxed);
+	lastShaderBuildMicroseconds.store(microseconds, std::memory_order_relaxed);
+}
+
+void recordAnimationEvaluation(double seconds) {
+	animationEvaluationsTotal.fetch_add(1, std::memory_order_relaxed);
+	animationMicrosecondsTotal.fetch_add(toMicroseconds(seconds), std::memory_order_relaxed);
+}
+
+//Adds the HELP and TYPE lines that come before a metric's samples.
+void describeMetric(std::string & exposition, const char * name, const char * type, const std::string & help) {
+	exposition += std::string("# HELP ") + name + " " + help + "\n";
+	exposition += std::string("# TYPE ") + name + " " + type + "\n";
+}
+
+void appendSample(std::string & exposition, const char * name, double value) {
+	char line[256];
+	snprintf(line, sizeof(line), "%s %.9g\n", name, value);
+	exposition += line;
+}
+
+//Reads every counter and writes them out in Prometheus' text format.
+//Rates and percentiles are worked out here, on the server's thread, so the render loop never pays for them.
+std::string sampleStats(uint64_t & previousFrames, std::chrono::steady_clock::time_point & previousSampleTime) {
+	std::string exposition;
+
+	uint64_t frames = framesTotal.load(std::memory_order_acquire);
+	std::chrono::steady_clock::time_point sampleTime = std::chrono::steady_clock::now();
+	double sampleSeconds = std::chrono::duration<double>(sampleTime - previousSampleTime).count();
+	double framesPerSecond = sampleSeconds > 0 ? (frames - previousFrames) / sampleSeconds : 0;
+	previousFrames = frames;
+	previousSampleTime = sampleTime;
+
+	describeMetric(exposition, "gravelmarcher_frames_total", "counter", "Frames drawn since the show started.");
+	appendSample(exposition, "gravelmarcher_frames_total", (double)frames);
+	describeMetric(exposition, "gravelmarcher_fps", "gauge", "Frames per second since the last sample.");
+	appendSample(exposition, "gravelmarcher_fps", framesPerSecond);
+
+	std::vector<uint32_t> recentFrames((size_t)std::min<uint64_t>(frames, RUNTIME_STATS_FRAME_HISTORY));
+	for (size_t i = 0; i < recentFrames.size(); i++) {
+		recentFrames[i] = recentFrameMicroseconds[i].load(std::memory_order_relaxed);
+	}
+	std::sort(recentFrames.begin(), recentFrames.end());
+	describeMetric(exposition, "gravelmarcher_frame_time_seconds", "summary", "Frame time. The quantiles are over the last " + std::to_string(RUNTIME_STATS_FRAME_HISTORY) + " frames.");
+	if (!recentFrames.empty()) {
+		const char * quantileNames[] = { "0.5", "0.9", "0.99" };
+		const double quantiles[] = { 0.5, 0.9, 0.99 };
+		for (int i = 0; i < 3; i++) {
+			size_t rank = std::min((size_t)(quantiles[i] * recentFrames.size()), recentFrames.size() - 1);
+			std::string name = std::string("gravelmarcher_frame_time_seconds{quantile=\"") + quantileNames[i] + "\"}";
+			appendSample(exposition, name.c_str(), recentFrames[rank] / 1e6);
+		}
+	}
+	appendSample(exposition, "gravelmarcher_frame_time_seconds_sum", frameMicrosecondsTotal.load(std::memory_order_relaxed) / 1e6);
+	appendSample(exposition, "gravelmarcher_frame_time_seconds_count", (double)frames);
+
+	uint32_t sequence;
+	uint64_t stepsTotal, maxItersPixels, pixels;
+	uint32_t stepsMax;
+	do {
+		sequence = marchStatsSequence.load(std::memory_order_acquire);
+		stepsTotal = marchStepsTotal.load(std::memory_order_relaxed);
+		stepsMax = marchStepsMax.load(std::memory_order_relaxed);
+		maxItersPixels = marchMaxItersPixels.load(std::memory_order_relaxed);
+		pixels = marchedPixels.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+	} while ((sequence & 1) != 0 || sequence != marchStatsSequence.load(std::memory_order_relaxed));
+
+	//Until the first sampled frame has come back from the GPU, there's nothing to say
+	if (sequence != 0 && pixels > 0) {
+		describeMetric(exposition, "gravelmarcher_march_steps_average", "gauge", "Average camera ray march steps per marched pixel, in the last sampled frame.");
+		appendSample(exposition, "gravelmarcher_march_steps_average", (double)stepsTotal / pixels);
+		describeMetric(exposition, "gravelmarcher_march_steps_max", "gauge", "Most camera ray march steps any pixel took, in the last sampled frame.");
+		appendSample(exposition, "gravelmarcher_march_steps_max", stepsMax);
+		describeMetric(exposition, "gravelmarcher_march_max_iters_ratio", "gauge", "Fraction of marched pixels that stopped at STOP_MODE_MAX_ITERS, in the last sampled frame.");
+		appendSample(exposition, "gravelmarcher_march_max_iters_ratio", (double)maxItersPixels / pixels);
+	}
+
+	describeMetric(exposition, "gravelmarcher_shader_build_seconds", "summary", "Time to compile and link a shader program, at startup or on reload.");
+	appendSample(exposition, "gravelmarcher_shader_build_seconds_sum", shaderBuildMicrosecondsTotal.load(std::memory_order_relaxed) / 1e6);
+	appendSample(exposition, "gravelmarcher_shader_build_seconds_count", (double)shaderBuildsTotal.load(std::memory_order_relaxed));
+	describeMetric(exposition, "gravelmarcher_shader_build_last_seconds", "gauge", "Time the most recent shader program took to build.");
+	appendSample(exposition, "gravelmarcher_shader_build_last_seconds", lastShaderBuildMicroseconds.load(std::memory_order_relaxed) / 1e6);
+
+	describeMetric(exposition, "gravelmarcher_animation_evaluation_seconds", "summary", "Time to evaluate a frame's animation.");
+	appendSample(exposition, "gravelmarcher_animation_evaluation_seconds_sum", animationMicrosecondsTotal.load(std::memory_order_relaxed) / 1e6);
+	appendSample(exposition, "gravelmarcher_animation_evaluation_seconds_count", (double)animationEvaluationsTotal.load(std::memory_order_relaxed));
+
+	return exposition;
+}
+
+//Answers one client with the latest exposition, then hangs up.
+//It's wrapped in a bare HTTP response, which curl needs and anything reading the raw socket can skip past.
+void serveStats(StatsSocket client, const std::string & exposition) {
+	//Whatever the request was, the answer is the same, so it's read and thrown away
+	pollfd pollInfo = { client, POLLIN, 0 };
+	if (pollStatsSockets(&pollInfo, 1, statsRequestTimeout) > 0) {
+		char request[1024];
+		recv(client, request, sizeof(request), 0);
+	}
+
+	char header[256];
+	snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n", exposition.size());
+	std::string response = header + exposition;
+	size_t sent = 0;
+	while (sent < response.size()) {
+		int result = (int)send(client, response.c_str() + sent, (int)(response.size() - sent), MSG_NOSIGNAL);
+		if (result <= 0) break;
+		sent += result;
+	}
+	closeStatsSocket(client);
+}
+
+//Whether path is a socket file, so it's safe to clear away. Anything else there was put there by someone else, and gets left alone.
+bool isSocketFile(const char * path) {
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA(path, &findData);
+	if (find == INVALID_HANDLE_VALUE) return false;
+	FindClose(find);
+	return (findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) && findData.dwReserved0 == IO_REPARSE_TAG_AF_UNIX;
+#else
+	struct stat pathStat;
+	return lstat(path, &pathStat) == 0 && S_ISSOCK(pathStat.st_mode);
+#endif
+}
+
+bool startStatsServer(const char * socketPath) {
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(socketPath) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "Stats socket path %s is too long\n", socketPath);
+		return false;
+	}
+	strcpy(address.sun_path, socketPath);
+
+#ifdef _WIN32
+	WSADATA winsockData;
+	if (WSAStartup(MAKEWORD(2, 2), &winsockData) != 0) return false;
+#endif
+
+	//A socket file left behind by a run that crashed would stop bind from working.
+	//If something else is there, bind fails and says so, rather than whatever it is getting deleted.
+	if (isSocketFile(socketPath)) remove(socketPath);
+	statsListenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (statsListenSocket == invalidStatsSocket) {
+		fprintf(stderr, "Couldn't make the stats socket\n");
+		return false;
+	}
+	if (bind(statsListenSocket, (sockaddr *)&address, sizeof(address)) != 0 || listen(statsListenSocket, 4) != 0) {
+		fprintf(stderr, "Couldn't listen on %s\n", socketPath);
+		closeStatsSocket(statsListenSocket);
+		statsListenSocket = invalidStatsSocket;
+		return false;
+	}
+	statsServerSocketPath = socketPath;
+
+	statsServerThread = std::thread([]() {
+		uint64_t previousFrames = 0;
+		std::chrono::steady_clock::time_point previousSampleTime = std::chrono::steady_clock::now();
+		std::string exposition = sampleStats(previousFrames, previousSampleTime);
+
+		while (!statsServerQuitting) {
+			if (std::chrono::steady_clock::now() - previousSampleTime >= std::chrono::milliseconds(statsSamplePeriod)) {
+				exposition = sampleStats(previousFrames, previousSampleTime);
+			}
+
+			pollfd pollInfo = { statsListenSocket, POLLIN, 0 };
+			if (pollStatsSockets(&pollInfo, 1, statsServerPollInterval) <= 0) continue;
+			StatsSocket client = accept(statsListenSocket, NULL, NULL);
+			if (client != invalidStatsSocket) serveStats(client, exposition);
+		}
+	});
+
+	printf("Serving stats on %s\n", socketPath);
+	return true;
+}
+
+void stopStatsServer() {
+	if (statsListenSocket == invalidStatsSocket) return;
+	statsServerQuitting = true;
+	statsServerThread.join();
+	closeStatsSocket(statsListenSocket);
+	statsListenSocket = invalidStatsSocket;
+	remove(statsServerSocketPath.c_str());
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
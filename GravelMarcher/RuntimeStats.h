@@ -0,0 +1,28 @@
+#pragma once
+
+//Live numbers about a running show, for whoever's keeping an eye on it: frame rate and frame time percentiles, how hard the marcher
+//is working, and how long shader builds and animation evaluation take.
+//The record functions are just relaxed atomic adds and stores, so they're safe to call from any thread and never wait on anything.
+//A background thread samples the counters and serves them over a Unix domain socket, in Prometheus' text format.
+//Scrape it with: curl --unix-socket <socketPath> http://localhost/metrics
+
+#include <stdint.h>
+
+//How many of the most recent frames the frame time percentiles are taken over.
+#define RUNTIME_STATS_FRAME_HISTORY 1024
+
+//Called by the render loop once a frame.
+void recordFrameTime(double seconds);
+
+//Called whenever a frame marched with the march statistics on has been read back.
+void recordMarchStats(uint64_t stepsTotal, uint32_t stepsMax, uint64_t maxItersPixels, uint64_t marchedPixels);
+
+//Called for every program built, whether at startup or by the shader reloader.
+void recordShaderBuild(double seconds);
+
+//Called for every frame whose animation is evaluated.
+void recordAnimationEvaluation(double seconds);
+
+//Starts serving on socketPath, replacing anything already there. Returns false if the socket couldn't be set up.
+bool startStatsServer(const char * socketPath);
+void stopStatsServer();
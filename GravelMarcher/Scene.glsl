@@ -0,0 +1,161 @@
+//------------------------------------The scene-----------------------------------------
+//The parts of the scene that more than the marcher needs. TileCull.glsl and the wavefront stages include this too,
+//so they always agree on what's there. Anything that includes it has to include FrameParams.glsl first, for the colors.
+
+#define STOP_MODE_TOO_FAR 0
+#define STOP_MODE_MAX_ITERS 1
+#define STOP_MODE_CLOSE_ENOUGH 2
+
+//How close the ray has to march to the SDF until it's considered 'on' it.
+const float camRayCloseEnough = 0.001f;
+
+//How far from the camera the ray stops marching. (This should also be when the 'fog' hits 1)
+const float camRayTooFar = 1000.0f;
+
+//The maximum number of marching steps the SLDF can take before it just gives the sky color
+const uint camRayMaxSteps = 4000;
+
+//The maximum number of steps to take while shadow marching. Should be much lower than the actual max steps.
+const uint shadowRayMaxSteps = 100;
+
+const float shadowRayTooFar = 100.0f;
+
+//---------------------------------Shader geometry constants----------------------------
+
+const float sphereRadius = 1.0f;
+const vec3 sphereCenter = vec3(0, 0, 0);
+
+const vec3 floorNormal = vec3(0, 1, 0);
+const float floorOffset = -1.0f;
+
+//How often the scene repeats along x and z. Main.cpp's sceneRepetitionPeriod has to match.
+const float repetitionPeriod = 4.0f;
+
+//Repeats the scene every repetitionPeriod units along x and z. Main.cpp rebases the camera into the cell it's in every frame,
+//so p is always small here, and this is exact.
+vec3 deformation(vec3 p) {
+	//return p;
+	return mod(p + vec3(repetitionPeriod / 2, 0, repetitionPeriod / 2), vec3(repetitionPeriod, 0, repetitionPeriod)) - vec3(repetitionPeriod / 2, 0, repetitionPeriod / 2);
+}
+
+//A union that blends the two together within about k of where they meet. The polynomial smooth minimum.
+//Scenes written out as GLSL by SdfKernels.h can use it.
+float smoothUnion(float a, float b, float k) {
+	float h = clamp(0.5f + 0.5f * (b - a) / k, 0.0f, 1.0f);
+	return mix(b, a, h) - k * h * (1.0f - h);
+}
+
+//sceneDistance(p), the distance half of sdf(). Main.cpp generates it from gravelScene() in SdfKernels.h, so there's no file on disk.
+#include "SceneDistance.glsl"
+
+//-----------------------------------SDF Output variables---------------------------------------
+//These are modified (really set) as the SDF evaluates, then other parts of the program can look at them to see what's up
+
+//The actual value of the SDF. Represents a lower bound on the distance from the point the SDF was evaluated at, to the nearest geometry.
+//The sign is significant. Positive means the point is outside an object, negative means inside, 0 means it's on a surface.
+float sdfValue;
+
+//The normal of the surface closest to the point the SDF was evaluated at.
+vec3 surfaceNormal;
+
+//The diffuse color of the surface closest to the point the SDF was evaluated at.
+vec3 surfaceDiffuse;
+
+//The specular color of blah blah blah
+vec3 surfaceSpecular;
+
+//The specular exponent (shininess) of the surface
+float surfaceShininess;
+
+//The actual SDF. This is where the real meat of the scene is. The distance is gravelScene() in SdfKernels.h,
+//so that's where the scene's shape changes. The colors are picked here, from whichever object is nearest.
+void sdf(vec3 p, bool includeColorCalcs) {
+	sdfValue = sceneDistance(p);
+	if(!includeColorCalcs) return;
+
+	//The coloring data. Only needed if includeColorCalcs was true.
+	//First applies the space deformation.
+	vec3 pp = deformation(p);
+
+	vec3 ppc = pp - sphereCenter;
+	float sdfSphereValue = length(ppc) - sphereRadius;
+	float sdfPlaneValue = dot((pp - floorOffset * floorNormal), floorNormal);
+
+	if(sdfSphereValue < sdfPlaneValue) {
+		surfaceNormal = normalize(ppc);
+		surfaceDiffuse = ballsDiffuse;
+		surfaceSpecular = ballsSpecular;
+		surfaceShininess = ballsShininess;
+
+	} else {
+		surfaceNormal = floorNormal;
+		surfaceDiffuse = floorDiffuse;
+		surfaceSpecular = floorSpecular;
+		surfaceShininess = floorShininess;
+	}
+
+}
+
+//-------------------------------Interval evaluation-------------------------------------
+//The scene, evaluated over a whole box of points at once. Each function gives a range, low end in x and high end in y,
+//that the SDF is guaranteed to stay in anywhere in the box. TileCull.glsl uses it to prove stretches of rays can't hit anything.
+//Every primitive and operation sdf() uses needs one of these, or the culling goes wrong.
+
+//The ranges a box's extent along one repeated axis lands in after deformation(). Crossing one cell boundary splits it in two,
+//one piece at each end of the cell. Crossing more than that could land anywhere in the cell. Returns how many ranges there are.
+int intervalRepetition(float low, float high, out vec2 ranges[2]) {
+	float firstCell = floor((low + repetitionPeriod / 2) / repetitionPeriod);
+	float lastCell = floor((high + repetitionPeriod / 2) / repetitionPeriod);
+	if(firstCell == lastCell) {
+		ranges[0] = vec2(low, high) - firstCell * repetitionPeriod;
+		return 1;
+	}
+	if(lastCell == firstCell + 1) {
+		ranges[0] = vec2(low - firstCell * repetitionPeriod, repetitionPeriod / 2);
+		ranges[1] = vec2(-repetitionPeriod / 2, high - lastCell * repetitionPeriod);
+		return 2;
+	}
+	ranges[0] = vec2(-repetitionPeriod / 2, repetitionPeriod / 2);
+	return 1;
+}
+
+vec2 intervalSphere(vec3 boxMin, vec3 boxMax, vec3 center, float radius) {
+	vec3 nearest = clamp(center, boxMin, boxMax);
+	vec3 farthest = max(abs(boxMin - center), abs(boxMax - center));
+	return vec2(length(nearest - center), length(farthest)) - radius;
+}
+
+//The plane's distance is linear, so its extremes are at the corners that go furthest each way along the normal.
+vec2 intervalPlane(vec3 boxMin, vec3 boxMax, vec3 normal, float offset) {
+	vec3 lowCorner = mix(boxMax, boxMin, step(0.0f, normal));
+	vec3 highCorner = mix(boxMin, boxMax, step(0.0f, normal));
+	return vec2(dot(lowCorner - offset * normal, normal), dot(highCorner - offset * normal, normal));
+}
+
+//The same scene as sdf(), over a box that's already been through deformation(). A union is the smaller of the two at both ends.
+vec2 sdfIntervalInCell(vec3 boxMin, vec3 boxMax) {
+	vec2 sphere = intervalSphere(boxMin, boxMax, sphereCenter, sphereRadius);
+	vec2 plane = intervalPlane(boxMin, boxMax, floorNormal, floorOffset);
+	return min(sphere, plane);
+}
+
+//The range of sdf() over a box anywhere in the world. The box is split into the pieces deformation() sends it to,
+//and the range covers all of them.
+vec2 sdfInterval(vec3 boxMin, vec3 boxMax) {
+	vec2 xRanges[2];
+	vec2 zRanges[2];
+	int xRangeCount = intervalRepetition(boxMin.x, boxMax.x, xRanges);
+	int zRangeCount = intervalRepetition(boxMin.z, boxMax.z, zRanges);
+
+	vec2 range = vec2(1e20f, -1e20f);
+	for(int x = 0; x < xRangeCount; x++) {
+		for(int z = 0; z < zRangeCount; z++) {
+			vec2 pieceRange = sdfIntervalInCell(
+				vec3(xRanges[x].x, boxMin.y, zRanges[z].x),
+				vec3(xRanges[x].y, boxMax.y, zRanges[z].y)
+			);
+			range = vec2(min(range.x, pieceRange.x), max(range.y, pieceRange.y));
+		}
+	}
+	return range;
+}
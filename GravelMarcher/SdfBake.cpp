@@ -0,0 +1,81 @@
+#include "SdfBake.h"
+#include "SdfKernels.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+using namespace glm;
+
+//The box a bake covers: one repetition cell across, and tall enough for the floor and the spheres.
+const vec3 sdfBakeMin = vec3(-2, -2, -2);
+const vec3 sdfBakeMax = vec3(2, 2, 2);
+const int sdfBakeDefaultResolution = 128;
+
+int runSdfBake(int argc, char* argv[]) {
+	if (argc < 3) {
+		fprintf(stderr, "Usage: GravelMarcher --bake-sdf <outputPath> [resolution]\n");
+		return -1;
+	}
+	std::string outputPath = argv[2];
+	int resolution = argc >= 4 && isdigit(argv[3][0]) ? std::max(atoi(argv[3]), 1) : sdfBakeDefaultResolution;
+
+	auto scene = gravelScene();
+	std::vector<float> grid((size_t)resolution * resolution * resolution);
+	vec3 cellSize = (sdfBakeMax - sdfBakeMin) / (float)resolution;
+
+	auto bakeStart = std::chrono::high_resolution_clock::now();
+
+	//Each thread takes whole slices of the grid, a row of points at a time
+	std::atomic<int> nextSlice(0);
+	std::vector<std::thread> threads;
+	int threadCount = std::max((int)std::thread::hardware_concurrency(), 1);
+	for (int t = 0; t < threadCount; t++) {
+		threads.push_back(std::thread([&]() {
+			std::vector<float> xs(resolution), ys(resolution), zs(resolution);
+			for (int i = 0; i < resolution; i++) {
+				xs[i] = sdfBakeMin.x + (i + 0.5f) * cellSize.x;
+			}
+			for (int z = nextSlice++; z < resolution; z = nextSlice++) {
+				for (int y = 0; y < resolution; y++) {
+					std::fill(ys.begin(), ys.end(), sdfBakeMin.y + (y + 0.5f) * cellSize.y);
+					std::fill(zs.begin(), zs.end(), sdfBakeMin.z + (z + 0.5f) * cellSize.z);
+					evaluateSdf(scene, &xs[0], &ys[0], &zs[0], &grid[((size_t)z * resolution + y) * resolution], resolution);
+				}
+			}
+		}));
+	}
+	for (std::thread & thread : threads) thread.join();
+
+	double bakeSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - bakeStart).count();
+
+	FILE * output = fopen(outputPath.c_str(), "wb");
+	if (output == NULL || fwrite(&grid[0], sizeof(float), grid.size(), output) != grid.size()) {
+		fprintf(stderr, "Couldn't write %s\n", outputPath.c_str());
+		if (output != NULL) fclose(output);
+		return -1;
+	}
+	fclose(output);
+
+	std::string glslPath = outputPath + ".glsl";
+	FILE * glslOutput = fopen(glslPath.c_str(), "w");
+	if (glslOutput == NULL) {
+		fprintf(stderr, "Couldn't write %s\n", glslPath.c_str());
+		return -1;
+	}
+	fprintf(glslOutput, "//The scene baked into %s, as GLSL. Needs smoothUnion from Scene.glsl if it uses one.\n", outputPath.c_str());
+	fprintf(glslOutput, "float bakedSceneDistance(vec3 p) {\n\treturn %s;\n}\n", scene.glsl("p").c_str());
+	fclose(glslOutput);
+
+	printf("Baked %d^3 points in %.1f ms (%.1f million points/s) on %d threads\n",
+		resolution, bakeSeconds * 1000.0, grid.size() / bakeSeconds / 1e6, threadCount);
+	return 0;
+}
+
@@ -0,0 +1,7 @@
+#pragma once
+
+//Bakes the scene's SDF into a grid on the CPU, with the packet kernels from SdfKernels.h.
+//Usage: GravelMarcher --bake-sdf <outputPath> [resolution]
+//The output is resolution^3 raw 32 bit floats, x fastest then y then z, sampled at cell centers across one repetition cell.
+//Next to it goes <outputPath>.glsl, the GLSL for exactly the scene that was baked.
+int runSdfBake(int argc, char* argv[]);
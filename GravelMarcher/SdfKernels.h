@@ -0,0 +1,246 @@
+#pragma once
+
+//The scene's SDF, for evaluating on the CPU. Scenes are built out of expression templates (Sphere, Plane, Repeat, Union, SmoothUnion),
+//so each scene is its own type, and the compiler inlines the whole tree into one straight-line function with no virtual calls.
+//Points come in packets of SDF_PACKET_WIDTH, stored one array per coordinate, and every operation works on a whole packet at once.
+//With AVX2 a packet is one register. Without it, it's a plain array the compiler is free to vectorize.
+//The primitives mirror the ones sdf() in Scene.glsl is built from, and each node can also write itself out as GLSL,
+//so one scene definition can drive both the GPU and the CPU. sdf()'s distance is generated from gravelScene() this way.
+
+#include <math.h>
+#include <stdio.h>
+
+#include <string>
+#include <algorithm>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <glm.hpp>
+
+#define SDF_PACKET_WIDTH 8
+
+//------------------------------------Packets-------------------------------------------
+
+#ifdef __AVX2__
+
+struct FloatPacket {
+	__m256 v;
+};
+
+inline FloatPacket packetBroadcast(float f) { return { _mm256_set1_ps(f) }; }
+inline FloatPacket packetLoad(const float * p) { return { _mm256_loadu_ps(p) }; }
+inline void packetStore(float * p, FloatPacket a) { _mm256_storeu_ps(p, a.v); }
+inline FloatPacket operator+(FloatPacket a, FloatPacket b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline FloatPacket operator-(FloatPacket a, FloatPacket b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline FloatPacket operator*(FloatPacket a, FloatPacket b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline FloatPacket operator/(FloatPacket a, FloatPacket b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline FloatPacket packetMin(FloatPacket a, FloatPacket b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline FloatPacket packetMax(FloatPacket a, FloatPacket b) { return { _mm256_max_ps(a.v, b.v) }; }
+inline FloatPacket packetSqrt(FloatPacket a) { return { _mm256_sqrt_ps(a.v) }; }
+inline FloatPacket packetFloor(FloatPacket a) { return { _mm256_floor_ps(a.v) }; }
+
+//MSVC's /arch:AVX2 brings FMA along with it. Other compilers have to be asked for it separately.
+#if defined(__FMA__) || defined(_MSC_VER)
+inline FloatPacket packetFusedMultiplyAdd(FloatPacket a, FloatPacket b, FloatPacket c) { return { _mm256_fmadd_ps(a.v, b.v, c.v) }; }
+#else
+inline FloatPacket packetFusedMultiplyAdd(FloatPacket a, FloatPacket b, FloatPacket c) { return { _mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v) }; }
+#endif
+
+#else
+
+struct FloatPacket {
+	float v[SDF_PACKET_WIDTH];
+};
+
+#define SDF_PACKET_LANEWISE(expression) FloatPacket r; for (int i = 0; i < SDF_PACKET_WIDTH; i++) r.v[i] = (expression); return r;
+
+inline FloatPacket packetBroadcast(float f) { SDF_PACKET_LANEWISE(f) }
+inline FloatPacket packetLoad(const float * p) { SDF_PACKET_LANEWISE(p[i]) }
+inline void packetStore(float * p, FloatPacket a) { for (int i = 0; i < SDF_PACKET_WIDTH; i++) p[i] = a.v[i]; }
+inline FloatPacket operator+(FloatPacket a, FloatPacket b) { SDF_PACKET_LANEWISE(a.v[i] + b.v[i]) }
+inline FloatPacket operator-(FloatPacket a, FloatPacket b) { SDF_PACKET_LANEWISE(a.v[i] - b.v[i]) }
+inline FloatPacket operator*(FloatPacket a, FloatPacket b) { SDF_PACKET_LANEWISE(a.v[i] * b.v[i]) }
+inline FloatPacket operator/(FloatPacket a, FloatPacket b) { SDF_PACKET_LANEWISE(a.v[i] / b.v[i]) }
+inline FloatPacket packetMin(FloatPacket a, FloatPacket b) { SDF_PACKET_LANEWISE(std::min(a.v[i], b.v[i])) }
+inline FloatPacket packetMax(FloatPacket a, FloatPacket b) { SDF_PACKET_LANEWISE(std::max(a.v[i], b.v[i])) }
+inline FloatPacket packetSqrt(FloatPacket a) { SDF_PACKET_LANEWISE(sqrtf(a.v[i])) }
+inline FloatPacket packetFloor(FloatPacket a) { SDF_PACKET_LANEWISE(floorf(a.v[i])) }
+inline FloatPacket packetFusedMultiplyAdd(FloatPacket a, FloatPacket b, FloatPacket c) { SDF_PACKET_LANEWISE(a.v[i] * b.v[i] + c.v[i]) }
+
+#undef SDF_PACKET_LANEWISE
+
+#endif
+
+inline FloatPacket packetClamp(FloatPacket a, float low, float high) { return packetMin(packetMax(a, packetBroadcast(low)), packetBroadcast(high)); }
+
+//GLSL's mod, which unlike fmod always comes out with the sign of m.
+inline FloatPacket packetMod(FloatPacket a, float m) { return a - packetBroadcast(m) * packetFloor(a * packetBroadcast(1.0f / m)); }
+
+//A packet of points, one array per coordinate.
+struct PointPacket {
+	FloatPacket x;
+	FloatPacket y;
+	FloatPacket z;
+};
+
+//Floats written out so GLSL reads them back exactly.
+inline std::string sdfGLSLFloat(float f) {
+	char text[32];
+	snprintf(text, sizeof(text), "%.9g", f);
+	std::string s = text;
+	if (s.find_first_of(".eEni") == std::string::npos) s += ".0";
+	return s;
+}
+
+inline std::string sdfGLSLVec3(glm::vec3 v) {
+	return "vec3(" + sdfGLSLFloat(v.x) + ", " + sdfGLSLFloat(v.y) + ", " + sdfGLSLFloat(v.z) + ")";
+}
+
+//-----------------------------------Primitives-----------------------------------------
+//Every node has distance(), which takes a packet of points and gives their distances, and glsl(), which gives a GLSL expression
+//for the distance at the point named p.
+
+struct Sphere {
+	glm::vec3 center;
+	float radius;
+
+	FloatPacket distance(const PointPacket & p) const {
+		FloatPacket dx = p.x - packetBroadcast(center.x);
+		FloatPacket dy = p.y - packetBroadcast(center.y);
+		FloatPacket dz = p.z - packetBroadcast(center.z);
+		FloatPacket lengthSquared = packetFusedMultiplyAdd(dx, dx, packetFusedMultiplyAdd(dy, dy, dz * dz));
+		return packetSqrt(lengthSquared) - packetBroadcast(radius);
+	}
+
+	std::string glsl(const std::string & p) const {
+		return "(length(" + p + " - " + sdfGLSLVec3(center) + ") - " + sdfGLSLFloat(radius) + ")";
+	}
+};
+
+//Everything on the side normal points to is outside. The plane sits offset along normal from the origin. normal has to be unit length.
+struct Plane {
+	glm::vec3 normal;
+	float offset;
+
+	FloatPacket distance(const PointPacket & p) const {
+		FloatPacket d = packetFusedMultiplyAdd(p.x, packetBroadcast(normal.x), packetFusedMultiplyAdd(p.y, packetBroadcast(normal.y), p.z * packetBroadcast(normal.z)));
+		return d - packetBroadcast(offset);
+	}
+
+	std::string glsl(const std::string & p) const {
+		return "dot(" + p + " - " + sdfGLSLFloat(offset) + " * " + sdfGLSLVec3(normal) + ", " + sdfGLSLVec3(normal) + ")";
+	}
+};
+
+//------------------------------------Operations-----------------------------------------
+
+//Repeats Child every period units along x and z, like deformation() in Scene.glsl. y is left alone.
+template <typename Child>
+struct Repeat {
+	float period;
+	Child child;
+
+	FloatPacket distance(const PointPacket & p) const {
+		FloatPacket half = packetBroadcast(period / 2);
+		PointPacket repeated;
+		repeated.x = packetMod(p.x + half, period) - half;
+		repeated.y = p.y;
+		repeated.z = packetMod(p.z + half, period) - half;
+		return child.distance(repeated);
+	}
+
+	std::string glsl(const std::string & p) const {
+		std::string half = sdfGLSLFloat(period / 2);
+		std::string repeated = "vec3(mod(" + p + ".x + " + half + ", " + sdfGLSLFloat(period) + ") - " + half + ", " + p + ".y, mod(" + p + ".z + " + half + ", " + sdfGLSLFloat(period) + ") - " + half + ")";
+		return child.glsl(repeated);
+	}
+};
+
+template <typename A, typename B>
+struct Union {
+	A a;
+	B b;
+
+	FloatPacket distance(const PointPacket & p) const {
+		return packetMin(a.distance(p), b.distance(p));
+	}
+
+	std::string glsl(const std::string & p) const {
+		return "min(" + a.glsl(p) + ", " + b.glsl(p) + ")";
+	}
+};
+
+//A union that blends the two together within about k of where they meet. The polynomial smooth minimum.
+template <typename A, typename B>
+struct SmoothUnion {
+	A a;
+	B b;
+	float k;
+
+	FloatPacket distance(const PointPacket & p) const {
+		FloatPacket da = a.distance(p);
+		FloatPacket db = b.distance(p);
+		FloatPacket h = packetClamp(packetBroadcast(0.5f) + packetBroadcast(0.5f / k) * (db - da), 0.0f, 1.0f);
+		FloatPacket blended = db + h * (da - db);
+		return blended - packetBroadcast(k) * h * (packetBroadcast(1.0f) - h);
+	}
+
+	std::string glsl(const std::string & p) const {
+		return "smoothUnion(" + a.glsl(p) + ", " + b.glsl(p) + ", " + sdfGLSLFloat(k) + ")";
+	}
+};
+
+//-------------------------------------Builders------------------------------------------
+//These let a scene be written as one nested expression, without spelling out its type.
+
+inline Sphere sdfSphere(glm::vec3 center, float radius) { return { center, radius }; }
+inline Plane sdfPlane(glm::vec3 normal, float offset) { return { normal, offset }; }
+template <typename Child> Repeat<Child> sdfRepeat(float period, Child child) { return { period, child }; }
+template <typename A, typename B> Union<A, B> sdfUnion(A a, B b) { return { a, b }; }
+template <typename A, typename B> SmoothUnion<A, B> sdfSmoothUnion(A a, B b, float k) { return { a, b, k }; }
+
+//---------------------------------------Scenes------------------------------------------
+
+//The scene sdf() in Scene.glsl marches. Its distance comes straight from here, through gravelSceneDistanceGLSL.
+//Scene.glsl's materials and interval evaluation are still written by hand, with the constants from the same file,
+//so a change here has to be made there too.
+inline auto gravelScene() {
+	return sdfRepeat(4.0f, sdfUnion(
+		sdfSphere(glm::vec3(0, 0, 0), 1.0f),
+		sdfPlane(glm::vec3(0, 1, 0), -1.0f)
+	));
+}
+
+//gravelScene()'s distance as the GLSL function sceneDistance. Main.cpp hands it to the shaders as SceneDistance.glsl,
+//a file that only exists in memory, so the GPU and CPU scenes can't drift apart.
+inline std::string gravelSceneDistanceGLSL() {
+	return "float sceneDistance(vec3 p) {\n\treturn " + gravelScene().glsl("p") + ";\n}\n";
+}
+
+//Evaluates scene at count points, stored one array per coordinate, into distances. count doesn't have to be a multiple of the packet width.
+template <typename Scene>
+void evaluateSdf(const Scene & scene, const float * x, const float * y, const float * z, float * distances, int count) {
+	int i = 0;
+	for (; i + SDF_PACKET_WIDTH <= count; i += SDF_PACKET_WIDTH) {
+		PointPacket p = { packetLoad(x + i), packetLoad(y + i), packetLoad(z + i) };
+		packetStore(distances + i, scene.distance(p));
+	}
+
+	//The leftovers go through a padded packet
+	if (i < count) {
+		float padded[3][SDF_PACKET_WIDTH] = {};
+		float paddedDistances[SDF_PACKET_WIDTH];
+		for (int j = 0; j < count - i; j++) {
+			padded[0][j] = x[i + j];
+			padded[1][j] = y[i + j];
+			padded[2][j] = z[i + j];
+		}
+		PointPacket p = { packetLoad(padded[0]), packetLoad(padded[1]), packetLoad(padded[2]) };
+		packetStore(paddedDistances, scene.distance(p));
+		for (int j = 0; j < count - i; j++) {
+			distances[i + j] = paddedDistances[j];
+		}
+	}
+}
@@ -0,0 +1,39 @@
+//------------------------------------Shading-------------------------------------------
+//How a point the camera ray hit gets lit. FragmentMarcher.glsl and WavefrontShade.glsl both include this, so the two paths light the scene the same.
+//Has to come after FrameParams.glsl.
+
+//This is a function that determines how the fog falls off with distance.
+//Different functions can give very different feels to a scene.
+float fogFalloff(float d) {
+	return d;
+}
+
+//The light the sun puts on a point that isn't in shadow, seen from eyePosition.
+vec3 sunLighting(vec3 hitPoint, vec3 eyePosition, vec3 normal, vec3 diffuse, vec3 specular, float shininess) {
+	if(!doLambertian){
+		return diffuse;
+	}
+	vec3 halfway = normalize(normalize(eyePosition - hitPoint) + sunDirection);
+	return
+		/*The diffuse component*/	diffuse * max(dot(normal, sunDirection), 0.0f) + 
+		/*The specular component*/	specular * pow(max(dot(halfway, normal), 0.0f), shininess)
+	;
+}
+
+//Squashes a unit vector into two components in [-1, 1], by projecting it onto an octahedron and unfolding the bottom half.
+vec2 octahedralEncode(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	if(n.z < 0) {
+		n.xy = (1.0f - abs(n.yx)) * vec2(n.x >= 0 ? 1.0f : -1.0f, n.y >= 0 ? 1.0f : -1.0f);
+	}
+	return n.xy;
+}
+
+//Undoes octahedralEncode. The sky's stored as (0, 0), which comes back as straight down the z axis, so check for sky some other way first.
+vec3 octahedralDecode(vec2 e) {
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	if(n.z < 0) {
+		n.xy = (1.0f - abs(n.yx)) * vec2(n.x >= 0 ? 1.0f : -1.0f, n.y >= 0 ? 1.0f : -1.0f);
+	}
+	return normalize(n);
+}
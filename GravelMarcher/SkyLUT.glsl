@@ -0,0 +1,29 @@
+#version 460 core
+
+#define PI 3.1415926535897932384626433832795
+
+//Fills in the sky LUT the marcher reads the sky from when a ray misses everything.
+//The sky only changes when the sun does, so this only runs then, instead of for every sky pixel every frame.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+#include "FrameParams.glsl"
+#include "SkyLUTMapping.glsl"
+
+layout(rgba16f, binding = 2) uniform writeonly image2D skyLUT;
+
+void main() {
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(skyLUT);
+	if(texel.x >= size.x || texel.y >= size.y) return;
+
+	//The sky is flat apart from the sun, so only the angle from the sun matters for now.
+	//A sky that fades toward the horizon would use the elevation in angles.y too.
+	vec2 angles = skyLUTAngles((vec2(texel) + 0.5f) / vec2(size));
+	vec3 sky =
+		skyColor +
+		pow(max(cos(angles.x), 0.0f), sunShininess) * sunOverSat * sunColor
+	;
+
+	imageStore(skyLUT, texel, vec4(sky, 1));
+}
@@ -0,0 +1,21 @@
+//--------------------------------Sky LUT mapping-----------------------------------------
+//How directions map onto the sky LUT. Shared by the pass that fills it and the marcher that reads it, so the two can't disagree.
+//Needs FrameParams for the sun direction, and PI.
+
+//Across is the angle from the sun, square rooted so the sun's tight highlight gets most of the texels.
+//Down is the elevation above the horizon, square rooted away from it so the horizon gets the most, like in Hillaire's sky-view LUT.
+//Together they cover everything a sky can vary by when it's symmetric about the sun, which sky scattering is.
+vec2 skyLUTCoordinates(vec3 direction) {
+	float sunAngle = acos(clamp(dot(direction, sunDirection), -1.0f, 1.0f));
+	float elevation = asin(clamp(direction.y, -1.0f, 1.0f));
+	return vec2(sqrt(sunAngle / PI), 0.5f + 0.5f * sign(elevation) * sqrt(abs(elevation) / (PI / 2)));
+}
+
+//The inverse of skyLUTCoordinates, giving the angle from the sun in x and the elevation in y.
+vec2 skyLUTAngles(vec2 coordinates) {
+	float elevationCoordinate = coordinates.y * 2 - 1;
+	return vec2(
+		coordinates.x * coordinates.x * PI,
+		sign(elevationCoordinate) * elevationCoordinate * elevationCoordinate * (PI / 2)
+	);
+}
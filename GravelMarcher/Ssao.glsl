@@ -0,0 +1,120 @@
+#version 460 core
+
+//Screen space ambient occlusion, horizon based, at half resolution. Darkens the flat ambient light in creases and under the balls
+//using only the depth and normal targets the marcher already wrote, so it costs the same however many steps the rays took.
+//Each workgroup reads its tile of the depth target, plus an apron around it, into shared memory once, as view space positions.
+//Every pixel then walks a few directions across the tile, keeping track of how far above its surface the horizon rises in each.
+//The radius is a fixed size in the world, but never reaches past the apron, so the cost per pixel has a hard limit.
+//SsaoUpsample.glsl brings the result back up to full resolution.
+
+#define SSAO_GROUP_SIZE 8
+
+//How many half resolution pixels past the group's own the tile reaches, which is the furthest any pixel can look
+#define SSAO_APRON 8
+#define SSAO_TILE_SIZE (SSAO_GROUP_SIZE + 2 * SSAO_APRON)
+
+layout(local_size_x = SSAO_GROUP_SIZE, local_size_y = SSAO_GROUP_SIZE) in;
+
+#include "FrameParams.glsl"
+#include "Scene.glsl"
+#include "Shading.glsl"
+
+layout(binding = 0) uniform sampler2D depthTarget;
+layout(binding = 1) uniform sampler2D normalTarget;
+
+//How much of the ambient light gets through, then the depth of the pixel that was worked out from, for the upsample to compare against
+layout(rg32f, binding = 5) uniform writeonly image2D occlusionImage;
+
+//How far, in world units, something can be and still block the ambient light
+const float ssaoRadius = 1.0f;
+
+//How many directions each pixel looks in, and how many steps it takes along each
+const int ssaoDirections = 8;
+const int ssaoSteps = 4;
+
+//Horizons that rise less than this above the surface are ignored, so flat ground doesn't occlude itself through depth imprecision
+const float ssaoHorizonBias = 0.1f;
+
+//How dark the fully occluded parts get. 1 takes all the ambient away.
+const float ssaoStrength = 1.0f;
+
+//The view space position of each half resolution pixel in the tile, with w 0 for sky or off the screen
+shared vec4 tilePositions[SSAO_TILE_SIZE * SSAO_TILE_SIZE];
+
+//The view space position of what full resolution pixel was hit, or w 0 if it was sky
+vec4 viewPosition(ivec2 pixel, ivec2 screenSize) {
+	if(any(lessThan(pixel, ivec2(0))) || any(greaterThanEqual(pixel, screenSize))) {
+		return vec4(0);
+	}
+	float depth = texelFetch(depthTarget, pixel, 0).r;
+	if(depth >= camRayTooFar) {
+		return vec4(0);
+	}
+	vec2 screenPosition = (vec2(pixel) + 0.5f) / vec2(screenSize) * 2 - 1;
+	vec3 rayView = normalize(vec3(screenPosition * vec2(screenRight, screenTop), -1));
+	return vec4(rayView * depth, 1);
+}
+
+void main() {
+	ivec2 screenSize = textureSize(depthTarget, 0);
+	ivec2 halfSize = (screenSize + 1) / 2;
+	ivec2 tileOrigin = ivec2(gl_WorkGroupID.xy) * SSAO_GROUP_SIZE - SSAO_APRON;
+
+	//Each half resolution pixel stands for the bottom left pixel of its 2x2 block
+	for(int i = int(gl_LocalInvocationIndex); i < SSAO_TILE_SIZE * SSAO_TILE_SIZE; i += SSAO_GROUP_SIZE * SSAO_GROUP_SIZE) {
+		ivec2 halfPixel = tileOrigin + ivec2(i % SSAO_TILE_SIZE, i / SSAO_TILE_SIZE);
+		tilePositions[i] = viewPosition(halfPixel * 2, screenSize);
+	}
+	barrier();
+
+	ivec2 halfPixel = ivec2(gl_GlobalInvocationID.xy);
+	if(any(greaterThanEqual(halfPixel, halfSize))) {
+		return;
+	}
+	ivec2 tilePixel = ivec2(gl_LocalInvocationID.xy) + SSAO_APRON;
+	vec4 center = tilePositions[tilePixel.y * SSAO_TILE_SIZE + tilePixel.x];
+	float depth = length(center.xyz);
+	if(center.w == 0) {
+		imageStore(occlusionImage, halfPixel, vec4(1, camRayTooFar, 0, 0));
+		return;
+	}
+	vec3 normal = mat3(matWorldToView) * octahedralDecode(texelFetch(normalTarget, halfPixel * 2, 0).rg);
+
+	//How many half resolution pixels ssaoRadius covers at this depth, cut off at the apron
+	float pixelsPerUnit = float(screenSize.x) / (4 * screenRight * -center.z);
+	float radiusPixels = min(ssaoRadius * pixelsPerUnit, float(SSAO_APRON));
+	if(radiusPixels < 1) {
+		imageStore(occlusionImage, halfPixel, vec4(1, depth, 0, 0));
+		return;
+	}
+
+	//Every pixel turns its directions and steps by a different amount, which swaps banding for noise the upsample smooths over
+	float jitter = fract(52.9829189f * fract(dot(vec2(halfPixel), vec2(0.06711056f, 0.00583715f))));
+
+	float occlusion = 0;
+	for(int direction = 0; direction < ssaoDirections; direction++) {
+		float angle = (direction + jitter) * (2 * 3.14159265f / ssaoDirections);
+		vec2 stepDirection = vec2(cos(angle), sin(angle));
+
+		//Each new highest horizon adds however much more of the sky it hides, faded out toward the radius
+		float highestHorizon = ssaoHorizonBias;
+		for(int s = 0; s < ssaoSteps; s++) {
+			float stepPixels = max((s + jitter) / ssaoSteps * radiusPixels, 1.0f);
+			ivec2 samplePixel = tilePixel + ivec2(round(stepDirection * stepPixels));
+			vec4 samplePosition = tilePositions[samplePixel.y * SSAO_TILE_SIZE + samplePixel.x];
+			if(samplePosition.w == 0) {
+				continue;
+			}
+			vec3 toSample = samplePosition.xyz - center.xyz;
+			float distanceSquared = dot(toSample, toSample);
+			float horizon = dot(normal, toSample) * inversesqrt(max(distanceSquared, 1e-8f));
+			if(horizon > highestHorizon) {
+				float falloff = max(1.0f - distanceSquared / (ssaoRadius * ssaoRadius), 0.0f);
+				occlusion += (horizon - highestHorizon) * falloff;
+				highestHorizon = horizon;
+			}
+		}
+	}
+	float ambientVisibility = clamp(1.0f - ssaoStrength * occlusion / ssaoDirections, 0.0f, 1.0f);
+	imageStore(occlusionImage, halfPixel, vec4(ambientVisibility, depth, 0, 0));
+}
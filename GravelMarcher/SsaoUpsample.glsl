@@ -0,0 +1,55 @@
+#version 460 core
+
+//Brings Ssao.glsl's half resolution occlusion up to full resolution, and takes the occluded part of each pixel's ambient light
+//back out of the color target. Each pixel mixes the four half resolution pixels around it like bilinear filtering would,
+//but weighs each by how close its depth is, so occlusion doesn't bleed across the edge of a ball onto whatever's behind it.
+//This draws into the color target with reverse subtract blending, which is how it takes light away without reading the color itself.
+
+#include "FrameParams.glsl"
+
+layout(binding = 0) uniform sampler2D depthTarget;
+layout(binding = 1) uniform sampler2D ambientTarget;
+layout(binding = 2) uniform sampler2D occlusionTexture;
+
+out vec3 occludedAmbient;
+
+//How quickly a half resolution pixel's weight drops off as its depth gets further from this pixel's, relative to the depth
+const float depthSharpness = 50.0f;
+
+void main() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec3 ambient = texelFetch(ambientTarget, pixel, 0).rgb;
+	if(ambient == vec3(0, 0, 0)) {
+		discard;
+	}
+	float depth = texelFetch(depthTarget, pixel, 0).r;
+
+	//Half resolution pixel p stands for full resolution pixel 2p, so this is where this pixel falls between them
+	vec2 halfPosition = vec2(pixel) * 0.5f;
+	ivec2 halfBase = ivec2(floor(halfPosition));
+	vec2 blend = halfPosition - vec2(halfBase);
+	ivec2 halfMax = textureSize(occlusionTexture, 0) - 1;
+
+	float visibilitySum = 0;
+	float weightSum = 0;
+	float nearestDepthDifference = 1e30f;
+	float nearestVisibility = 1;
+	for(int y = 0; y < 2; y++) {
+		for(int x = 0; x < 2; x++) {
+			vec2 occlusion = texelFetch(occlusionTexture, min(halfBase + ivec2(x, y), halfMax), 0).rg;
+			float bilinear = (x == 0 ? 1 - blend.x : blend.x) * (y == 0 ? 1 - blend.y : blend.y);
+			float depthDifference = abs(occlusion.g - depth) / depth;
+			float weight = bilinear * exp(-depthDifference * depthSharpness);
+			visibilitySum += occlusion.r * weight;
+			weightSum += weight;
+			if(depthDifference < nearestDepthDifference) {
+				nearestDepthDifference = depthDifference;
+				nearestVisibility = occlusion.r;
+			}
+		}
+	}
+
+	//On a thin edge, none of them might be anywhere near this depth, so it takes the closest one
+	float ambientVisibility = weightSum > 1e-4f ? visibilitySum / weightSum : nearestVisibility;
+	occludedAmbient = ambient * (1 - ambientVisibility);
+}
@@ -0,0 +1,82 @@
+#version 460 core
+
+//Works out how far each tile's rays can skip before marching, by evaluating the scene over the whole tile at once with interval arithmetic.
+//Each tile's rays fit in a cone from the camera. Stretches of the cone are wrapped in a box, and if sdfInterval says nothing in the box
+//is close enough to hit, every ray in the tile can skip that stretch. Stretches that work double in length, ones that don't halve,
+//until they're too short to get past the cone's width. A tile that gets all the way to camRayTooFar is pure sky.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+#include "FrameParams.glsl"
+#include "Scene.glsl"
+#include "TileCulling.glsl"
+
+layout(r32f, binding = 4) uniform writeonly image2D tileStartDistanceImage;
+
+//Only here for its size, which is the size of the screen.
+layout(binding = 0) uniform sampler2D depthTarget;
+
+//How long the first stretch is. It only sets where the doubling starts.
+const float firstStretchLength = 0.25f;
+
+//Stretches never get shorter than this, even right by the camera where the cone is thin.
+const float shortestStretch = 0.01f;
+
+const int maxCullSteps = 64;
+
+//How far a point at distance t along a ray at angle acos(cosAngle) from the axis can be from the point at distance middle on the axis
+float distanceFromAxisPoint(float t, float middle, float cosAngle) {
+	return sqrt(max(t * t + middle * middle - 2 * t * middle * cosAngle, 0.0f));
+}
+
+void main() {
+	ivec2 tile = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 tileCount = imageSize(tileStartDistanceImage);
+	if(tile.x >= tileCount.x || tile.y >= tileCount.y) return;
+
+	//The tile's edges, from -1 to 1 across the screen like the screen quad
+	vec2 screenSize = vec2(textureSize(depthTarget, 0));
+	vec2 tileLow = vec2(tile * TILE_CULL_SIZE) / screenSize * 2 - 1;
+	vec2 tileHigh = min(vec2((tile + 1) * TILE_CULL_SIZE) / screenSize, 1.0f) * 2 - 1;
+
+	//Multi-view doesn't cull, so there's only ever view 0 here
+	mat4 matViewToWorld = matCameraToWorld * matViewToCamera[0];
+	vec3 origin = (matViewToWorld * vec4(0, 0, 0, 1)).xyz;
+
+	//The cone around the tile's rays: its axis goes through the middle, and it's wide enough to take in the corners
+	vec3 corners[4];
+	vec3 axis = vec3(0);
+	for(int i = 0; i < 4; i++) {
+		vec2 corner = vec2((i & 1) == 0 ? tileLow.x : tileHigh.x, (i & 2) == 0 ? tileLow.y : tileHigh.y);
+		corners[i] = normalize((matViewToWorld * vec4(corner * vec2(screenRight, screenTop), -1, 0)).xyz);
+		axis += corners[i];
+	}
+	axis = normalize(axis);
+	float cosHalfAngle = 1;
+	for(int i = 0; i < 4; i++) {
+		cosHalfAngle = min(cosHalfAngle, dot(axis, corners[i]));
+	}
+	float sinHalfAngle = sqrt(max(1 - cosHalfAngle * cosHalfAngle, 0.0f));
+
+	float start = 0;
+	float stretchLength = firstStretchLength;
+	for(int cullStep = 0; cullStep < maxCullSteps && start < camRayTooFar; cullStep++) {
+		float end = start + stretchLength;
+
+		//A box around every point the tile's rays reach between start and end
+		float middle = (start + end) / 2;
+		float radius = max(distanceFromAxisPoint(start, middle, cosHalfAngle), distanceFromAxisPoint(end, middle, cosHalfAngle));
+		vec3 center = origin + axis * middle;
+
+		if(sdfInterval(center - radius, center + radius).x > camRayCloseEnough) {
+			start = end;
+			stretchLength *= 2;
+		}
+		else {
+			stretchLength /= 2;
+			if(stretchLength < max(shortestStretch, start * sinHalfAngle)) break;
+		}
+	}
+
+	imageStore(tileStartDistanceImage, tile, vec4(start));
+}
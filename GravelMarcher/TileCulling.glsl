@@ -0,0 +1,13 @@
+//---------------------------------Tile culling-------------------------------------------
+//Before the marcher runs, TileCull.glsl works out, for each square tile of the screen, how far every ray in it can go without hitting anything.
+//The marcher starts its rays that far out, and tiles that can't hit anything at all just draw the sky.
+//Shared by the two of them.
+
+#define TILE_CULL_SIZE 16
+
+//One texel per tile, holding the distance its rays can skip. camRayTooFar or more means the whole tile is sky.
+layout(binding = 5) uniform sampler2D tileStartDistances;
+
+float tileStartDistance(ivec2 pixel) {
+	return texelFetch(tileStartDistances, pixel / TILE_CULL_SIZE, 0).r;
+}
@@ -0,0 +1,28 @@
+//-----------------------------Variable-rate marching-------------------------------------
+//In variable-rate mode, the screen is cut into square tiles, and each one marches at a rate the rate map picks for it:
+//every pixel (0), one ray per 2x2 block (1), or one per 4x4 block (2). Each block's ray goes through its middle.
+//The marcher doesn't draw the whole screen. VariableRateTiles.glsl gives it one quad per tile, only as many pixels across as the tile
+//has blocks, so every fragment marches a block. A tile's blocks end up packed into the bottom left corner of its own part of the targets.
+//Shared by the marcher, the pass that spreads blocks back out, and the pass that rebuilds the rate map.
+
+#define VARIABLE_RATE_TILE_SIZE 16
+
+//One texel per tile, holding its rate.
+layout(binding = 4) uniform usampler2D variableRateMap;
+
+//How many pixels across the block holding this pixel is.
+int variableRateBlockSize(ivec2 pixel) {
+	return 1 << texelFetch(variableRateMap, pixel / VARIABLE_RATE_TILE_SIZE, 0).r;
+}
+
+//Where the block holding this pixel is packed in the targets.
+ivec2 variableRateTexel(ivec2 pixel) {
+	ivec2 tileOrigin = pixel - pixel % VARIABLE_RATE_TILE_SIZE;
+	return tileOrigin + (pixel - tileOrigin) / variableRateBlockSize(pixel);
+}
+
+//The bottom left pixel of the block packed into this texel. Only means anything for texels inside the tile's packed corner.
+ivec2 variableRateBlockOrigin(ivec2 texel) {
+	ivec2 tileOrigin = texel - texel % VARIABLE_RATE_TILE_SIZE;
+	return tileOrigin + (texel - tileOrigin) * variableRateBlockSize(texel);
+}
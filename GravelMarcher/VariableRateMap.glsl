@@ -0,0 +1,105 @@
+#version 460 core
+
+//Works out the rate each tile marches at next frame, from what it marched this frame.
+//Tiles with edges in them, which show up as very different step counts or a spread of brightness, march at full rate.
+//Flat ones like open sky and the far floor march coarser. With foveation on, the edges of the screen are coarser no matter what.
+//One workgroup does one tile, so the local size has to match VARIABLE_RATE_TILE_SIZE.
+
+layout(local_size_x = 16, local_size_y = 16) in;
+
+#include "FrameParams.glsl"
+#include "VariableRate.glsl"
+
+layout(r8ui, binding = 3) uniform uimage2D rateMap;
+
+//What the marcher drew this frame. Only the blocks it actually marched, packed into the tile's corner, are looked at.
+layout(binding = 0) uniform usampler2D stepsTarget;
+layout(binding = 1) uniform sampler2D colorTarget;
+
+//A tile whose brightness varies more than this, as a standard deviation, marches at full rate, or at 2x2 past the coarse one.
+const float fineContrast = 0.08f;
+const float coarseContrast = 0.02f;
+
+//A tile where the step counts spread over more than this fraction of the most steps marches at full rate, or at 2x2 past the coarse one.
+//Silhouettes have rays that barely miss taking far more steps than their neighbors.
+const float fineStepsSpread = 0.5f;
+const float coarseStepsSpread = 0.25f;
+
+//Step counts that differ by less than this never count as an edge. Short rays into the sky vary this much on their own.
+const uint minStepsSpread = 8;
+
+//With foveation on, past these fractions of the way from the center of the screen to a corner, tiles are at least 2x2, then 4x4.
+const float foveaInnerRadius = 0.6f;
+const float foveaOuterRadius = 0.9f;
+
+#define TILE_PIXELS (VARIABLE_RATE_TILE_SIZE * VARIABLE_RATE_TILE_SIZE)
+
+shared uint tileStepsMin[TILE_PIXELS];
+shared uint tileStepsMax[TILE_PIXELS];
+shared float tileLuminance[TILE_PIXELS];
+shared float tileLuminanceSquared[TILE_PIXELS];
+shared float tileMarched[TILE_PIXELS];
+
+void main() {
+	ivec2 tile = ivec2(gl_WorkGroupID.xy);
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 imageDimensions = textureSize(colorTarget, 0);
+	uint index = gl_LocalInvocationIndex;
+
+	//Only the tile's packed corner holds blocks, and blocks off the edge of the screen weren't marched
+	uint rate = imageLoad(rateMap, tile).r;
+	int blockSize = 1 << rate;
+	ivec2 inTile = pixel - tile * VARIABLE_RATE_TILE_SIZE;
+	bool marched = all(lessThan(inTile, ivec2(VARIABLE_RATE_TILE_SIZE / blockSize))) &&
+		all(lessThan(tile * VARIABLE_RATE_TILE_SIZE + inTile * blockSize, imageDimensions));
+
+	if(marched) {
+		uint steps = texelFetch(stepsTarget, pixel, 0).r;
+		float luminance = dot(texelFetch(colorTarget, pixel, 0).rgb, vec3(0.2126f, 0.7152f, 0.0722f));
+		tileStepsMin[index] = steps;
+		tileStepsMax[index] = steps;
+		tileLuminance[index] = luminance;
+		tileLuminanceSquared[index] = luminance * luminance;
+		tileMarched[index] = 1;
+	}
+	else {
+		tileStepsMin[index] = 0xFFFFFFFFu;
+		tileStepsMax[index] = 0;
+		tileLuminance[index] = 0;
+		tileLuminanceSquared[index] = 0;
+		tileMarched[index] = 0;
+	}
+
+	//Halves the tile down to one value, a step at a time
+	for(uint stride = TILE_PIXELS / 2; stride > 0; stride /= 2) {
+		barrier();
+		if(index < stride) {
+			tileStepsMin[index] = min(tileStepsMin[index], tileStepsMin[index + stride]);
+			tileStepsMax[index] = max(tileStepsMax[index], tileStepsMax[index + stride]);
+			tileLuminance[index] += tileLuminance[index + stride];
+			tileLuminanceSquared[index] += tileLuminanceSquared[index + stride];
+			tileMarched[index] += tileMarched[index + stride];
+		}
+	}
+	if(index != 0) return;
+
+	float count = max(tileMarched[0], 1.0f);
+	float mean = tileLuminance[0] / count;
+	float contrast = sqrt(max(tileLuminanceSquared[0] / count - mean * mean, 0.0f));
+	float stepsSpread = float(tileStepsMax[0] - min(tileStepsMin[0], tileStepsMax[0]));
+	float stepsScale = float(tileStepsMax[0]);
+
+	uint newRate = 2;
+	if(contrast > coarseContrast || (stepsSpread > minStepsSpread && stepsSpread > coarseStepsSpread * stepsScale)) newRate = 1;
+	if(contrast > fineContrast || (stepsSpread > minStepsSpread && stepsSpread > fineStepsSpread * stepsScale)) newRate = 0;
+
+	if(variableRateFoveated) {
+		vec2 tileCenter = (vec2(tile) + 0.5f) * VARIABLE_RATE_TILE_SIZE;
+		vec2 fromCenter = tileCenter / vec2(imageDimensions) * 2 - 1;
+		float radius = length(fromCenter) / sqrt(2.0f);
+		if(radius > foveaInnerRadius) newRate = max(newRate, 1u);
+		if(radius > foveaOuterRadius) newRate = 2;
+	}
+
+	imageStore(rateMap, tile, uvec4(newRate));
+}
@@ -0,0 +1,26 @@
+#version 460 core
+
+//Fills in the pixels the marcher skipped in variable-rate mode, by copying each block's packed march over the whole block. See VariableRate.glsl.
+//That's what coarse shading does in hardware too. The debug view tints each tile by its rate.
+
+#include "FrameParams.glsl"
+#include "VariableRate.glsl"
+
+//What the marcher drew this frame. Only each tile's packed corner is meaningful.
+layout(binding = 0) uniform sampler2D colorTarget;
+
+out vec3 color;
+
+//Full rate is left alone. 2x2 is tinted green and 4x4 blue.
+const vec3 rateTints[3] = vec3[](vec3(0), vec3(0, 1, 0), vec3(0, 0.3, 1));
+const float rateTintStrength = 0.4f;
+
+void main() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	int blockSize = variableRateBlockSize(pixel);
+	color = texelFetch(colorTarget, variableRateTexel(pixel), 0).rgb;
+
+	if(variableRateDebugView && blockSize > 1) {
+		color = mix(color, rateTints[findLSB(blockSize)], rateTintStrength);
+	}
+}
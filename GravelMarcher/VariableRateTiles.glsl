@@ -0,0 +1,27 @@
+#version 460 core
+
+//Places the marcher's quads in variable-rate mode, one instance per tile, row by row. Each quad covers only the bottom left corner
+//of its tile, as many pixels across as the tile has blocks, so the marcher runs once per block rather than once per pixel. See VariableRate.glsl.
+
+#include "FrameParams.glsl"
+#include "VariableRate.glsl"
+
+layout(location = 0) in vec3 vertexLocation_screen;
+
+//The ray through this corner of the quad. The marcher aims its own rays in this mode, since each of its fragments stands for a whole block.
+out vec3 rayView;
+flat out int viewIndex;
+
+void main() {
+	ivec2 mapSize = textureSize(variableRateMap, 0);
+	ivec2 tileOrigin = ivec2(gl_InstanceID % mapSize.x, gl_InstanceID / mapSize.x) * VARIABLE_RATE_TILE_SIZE;
+	int blocksAcross = VARIABLE_RATE_TILE_SIZE / variableRateBlockSize(tileOrigin);
+
+	//The screen quad's corners are at -1 and 1, so they're moved to the tile's packed corner, in pixels, then back to the screen
+	vec2 corner = vec2(tileOrigin) + (vertexLocation_screen.xy * 0.5f + 0.5f) * blocksAcross;
+	vec2 cornerScreen = corner / vec2(targetSize) * 2 - 1;
+	gl_Position = vec4(cornerScreen, vertexLocation_screen.z, 1);
+
+	rayView = vec3(cornerScreen * vec2(screenRight, screenTop), -1);
+	viewIndex = 0;
+}
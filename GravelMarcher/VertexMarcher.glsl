@@ -1,14 +1,27 @@
 #version 460 core
 
+//Lets each instance of the quad pick its own layer of the render targets, for multi-view rendering
+#extension GL_ARB_shader_viewport_layer_array : enable
+
+#include "FrameParams.glsl"
+
 layout(location = 0) in vec3 vertexLocation_screen;
 layout(location = 1) in vec3 vertexUV;
-layout(location = 2) in vec3 vertexRay_view;
 
 out vec3 rayView;
 
+//Which view this is, in multi-view rendering. Always 0 otherwise.
+flat out int viewIndex;
+
 void main() {
 	gl_Position.xyz = vertexLocation_screen;
 	gl_Position.w = 1;
 
-	rayView = vertexRay_view;
+	//The corners of the quad are the corners of the screen, 1 unit in front of the camera
+	rayView = vec3(vertexLocation_screen.xy * vec2(screenRight, screenTop), -1);
+
+	viewIndex = gl_InstanceID;
+#ifdef GL_ARB_shader_viewport_layer_array
+	gl_Layer = gl_InstanceID;
+#endif
 }
\ No newline at end of file
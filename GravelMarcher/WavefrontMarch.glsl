@@ -0,0 +1,114 @@
+//---------------------------------Wavefront marching------------------------------------
+//The persistent marching loop the wavefront stages share. Each stage is dispatched as a fixed number of workgroups, and each keeps
+//pulling batches of rays off its queue until the queue's empty. Rays are marched a few steps per round, and between rounds, any lane whose
+//ray has stopped picks up a new one from the group's batch. So a ray that hits a sphere in 20 steps doesn't leave its lane idling
+//next to one grazing the floor for thousands, the way it would in the fragment marcher.
+//The stage defines fetchRay and retireRay, then calls drainQueue from main.
+
+#define WAVEFRONT_GROUP_SIZE 64
+
+//How many steps each lane takes between chances to swap in a new ray. Smaller keeps lanes busier, bigger spends less time in barriers.
+#define WAVEFRONT_STEPS_PER_ROUND 16
+
+layout(local_size_x = WAVEFRONT_GROUP_SIZE) in;
+
+//The ray this lane is marching. fetchRay sets all of these but rayActive, rayStopMode and raySteps.
+bool rayActive;
+vec3 rayOrigin;
+vec3 rayDirection;
+vec3 rayPosition;
+float rayCloseEnough;
+float rayTooFar;
+uint rayMaxSteps;
+uint raySteps;
+uint rayStopMode;
+uint rayPixel;
+
+//Sets this lane up to march queue entry index. Returns false if there's nothing to march, so the lane takes another.
+bool fetchRay(uint index);
+
+//Called once this lane's ray has stopped, with rayStopMode saying why.
+void retireRay();
+
+//Marches this lane's ray for up to WAVEFRONT_STEPS_PER_ROUND steps. Returns true once it's stopped.
+//Stops and counts steps exactly like march() in FragmentMarcher.glsl, so the two paths see the same thing.
+bool advanceRay() {
+	for(int roundStep = 0; roundStep < WAVEFRONT_STEPS_PER_ROUND; roundStep++) {
+		if(raySteps >= rayMaxSteps) {
+			rayStopMode = STOP_MODE_MAX_ITERS;
+			return true;
+		}
+
+		sdf(rayPosition, false);
+		if(sdfValue < rayCloseEnough) {
+			rayStopMode = STOP_MODE_CLOSE_ENOUGH;
+			return true;
+		}
+
+		rayPosition += sdfValue * rayDirection;
+		if(length(rayPosition - rayOrigin) > rayTooFar) {
+			rayStopMode = STOP_MODE_TOO_FAR;
+			return true;
+		}
+		raySteps++;
+	}
+	return false;
+}
+
+//The group's current batch of queue entries. Lanes take entries from batchCursor up to batchEnd.
+shared uint batchCursor;
+shared uint batchEnd;
+
+//Set once a claim on the queue has come back empty
+shared bool queueDrained;
+
+//How many lanes had a ray to march this round
+shared uint activeLanes;
+
+void drainQueue(uint queue) {
+	rayActive = false;
+	if(gl_LocalInvocationIndex == 0) {
+		batchCursor = 0;
+		batchEnd = 0;
+		queueDrained = false;
+	}
+	barrier();
+
+	//Every barrier here is reached by the whole group, since whether to stop is decided from shared values everyone reads alike
+	while(true) {
+		//Once the batch is used up, one lane claims the next for the whole group
+		if(gl_LocalInvocationIndex == 0) {
+			if(batchCursor >= batchEnd && !queueDrained) {
+				uint batchStart = atomicAdd(queueClaimed[queue], uint(WAVEFRONT_GROUP_SIZE));
+				batchCursor = batchStart;
+				batchEnd = min(batchStart + WAVEFRONT_GROUP_SIZE, queueLength[queue]);
+				queueDrained = batchStart >= queueLength[queue];
+			}
+			activeLanes = 0;
+		}
+		barrier();
+
+		if(!rayActive) {
+			uint index = atomicAdd(batchCursor, 1u);
+			if(index < batchEnd) {
+				rayActive = fetchRay(index);
+			}
+		}
+		if(rayActive) {
+			atomicAdd(activeLanes, 1u);
+		}
+		barrier();
+
+		if(activeLanes == 0 && queueDrained) {
+			break;
+		}
+
+		if(rayActive && advanceRay()) {
+			retireRay();
+			rayActive = false;
+		}
+
+		//Nobody starts the next round, which resets activeLanes, until everyone's read it
+		barrier();
+	}
+}
@@ -0,0 +1,100 @@
+#version 460 core
+
+//Wavefront mode's first stage. Marches every pixel's camera ray, writes down where it stopped, and queues a shadow ray
+//for every hit that faces the sun, and for each point light the hit picks for one. See WavefrontQueues.glsl.
+
+#include "FrameParams.glsl"
+#include "Scene.glsl"
+#include "TileCulling.glsl"
+#include "Lights.glsl"
+#include "WavefrontQueues.glsl"
+#include "MarchStats.glsl"
+#include "WavefrontMarch.glsl"
+
+vec3 cameraPosition;
+
+bool fetchRay(uint index) {
+	uint blockArea = WAVEFRONT_PIXEL_BLOCK_SIZE * WAVEFRONT_PIXEL_BLOCK_SIZE;
+	uint blocksPerRow = (targetWidth + WAVEFRONT_PIXEL_BLOCK_SIZE - 1) / WAVEFRONT_PIXEL_BLOCK_SIZE;
+	uint block = index / blockArea;
+	uint indexInBlock = index % blockArea;
+	uvec2 pixel = uvec2(block % blocksPerRow, block / blocksPerRow) * WAVEFRONT_PIXEL_BLOCK_SIZE +
+		uvec2(indexInBlock % WAVEFRONT_PIXEL_BLOCK_SIZE, indexInBlock / WAVEFRONT_PIXEL_BLOCK_SIZE);
+
+	//The blocks hang off the right and bottom edges when the screen isn't a whole number of them
+	if(pixel.x >= targetWidth || pixel.y >= targetHeight) {
+		return false;
+	}
+	rayPixel = pixel.y * targetWidth + pixel.x;
+
+	//The same ray the fragment marcher interpolates for this pixel's center
+	vec2 pixelNDC = (vec2(pixel) + 0.5f) / vec2(targetWidth, targetHeight) * 2.0f - 1.0f;
+	vec3 pixelRayView = vec3(pixelNDC * vec2(screenRight, screenTop), -1);
+	rayDirection = normalize((matCameraToWorld * matViewToCamera[0] * vec4(pixelRayView, 0)).xyz);
+
+	float tileStart = tileCullEnabled ? tileStartDistance(ivec2(pixel)) : 0.0f;
+	rayOrigin = cameraPosition + rayDirection * tileStart;
+	rayPosition = rayOrigin;
+	rayCloseEnough = camRayCloseEnough;
+	rayTooFar = camRayTooFar - tileStart;
+	rayMaxSteps = camRayMaxSteps;
+	raySteps = 0;
+
+	//Tile culling already proved this ray is sky, so it's done before it starts
+	if(tileStart >= camRayTooFar) {
+		rayStopMode = STOP_MODE_TOO_FAR;
+		retireRay();
+		return false;
+	}
+	return true;
+}
+
+void retireRay() {
+	hits[rayPixel].endPoint = rayPosition;
+	hits[rayPixel].stepsAndStopMode = raySteps | (rayStopMode << 16);
+	if(collectMarchStats) {
+		countCameraRay(raySteps, rayStopMode);
+	}
+
+	blockedPointLights[rayPixel] = 0u;
+	if(rayStopMode == STOP_MODE_TOO_FAR) {
+		sunVisibilities[rayPixel] = 1.0f;
+		return;
+	}
+
+	//In shadow unless the shadow ray gets out. A surface facing away from the sun shadows itself, so it doesn't need one.
+	sunVisibilities[rayPixel] = 0.0f;
+	sdf(rayPosition, true);
+	vec3 hitPoint = rayStopMode == STOP_MODE_CLOSE_ENOUGH ? rayPosition - surfaceNormal * sdfValue : rayPosition;
+	bool sunShadowRay = dot(surfaceNormal, sunDirection) > 0;
+
+	//The point lights the shade stage will want shadow rays for, picked exactly the way it'll pick them
+	vec3 unshadowedLighting;
+	ivec2 pixel = ivec2(rayPixel % targetWidth, rayPixel / targetWidth);
+	float viewDepth = -(matWorldToView * vec4(hitPoint, 1)).z;
+	uint pointShadowRayMask = choosePointLightShadowRays(pixel, viewDepth, hitPoint, cameraPosition,
+		surfaceNormal, surfaceDiffuse, surfaceSpecular, surfaceShininess, unshadowedLighting);
+
+	//Every shadow ray from this pixel goes in the queue together, off a single atomic
+	uint shadowRayCount = (sunShadowRay ? 1u : 0u) + uint(bitCount(pointShadowRayMask));
+	if(shadowRayCount == 0) {
+		return;
+	}
+	uint shadowRayIndex = atomicAdd(queueLength[WAVEFRONT_QUEUE_SHADOW], shadowRayCount);
+	if(sunShadowRay) {
+		shadowRays[shadowRayIndex].origin = hitPoint + sunDirection * 0.01;
+		shadowRays[shadowRayIndex].pixelAndLight = rayPixel | (WAVEFRONT_SHADOW_RAY_SUN << WAVEFRONT_SHADOW_RAY_PIXEL_BITS);
+		shadowRayIndex++;
+	}
+	for(uint remaining = pointShadowRayMask; remaining != 0; remaining &= remaining - 1) {
+		int light = findLSB(remaining);
+		shadowRays[shadowRayIndex].origin = hitPoint + normalize(pointLightPositions[light].xyz - hitPoint) * 0.01;
+		shadowRays[shadowRayIndex].pixelAndLight = rayPixel | (uint(light + 1) << WAVEFRONT_SHADOW_RAY_PIXEL_BITS);
+		shadowRayIndex++;
+	}
+}
+
+void main() {
+	cameraPosition = (matCameraToWorld * matViewToCamera[0] * vec4(0, 0, 0, 1)).xyz;
+	drainQueue(WAVEFRONT_QUEUE_PRIMARY);
+}
@@ -0,0 +1,58 @@
+//---------------------------------Wavefront queues---------------------------------------
+//In wavefront mode, a frame isn't marched one fragment at a time, camera ray then shadow ray, start to finish.
+//WavefrontPrimary.glsl marches every camera ray and queues a shadow ray for each hit that faces the sun, and for each point light
+//the hit picks for one. WavefrontShadow.glsl marches those, and WavefrontShade.glsl lights each pixel from what the two found. These are the buffers they hand their work over in.
+//Main.cpp's WavefrontQueueHeader and WAVEFRONT_* defines have to match.
+
+#define WAVEFRONT_QUEUE_PRIMARY 0
+#define WAVEFRONT_QUEUE_SHADOW 1
+
+//Camera rays go through the screen a block of this many pixels square at a time, so the rays a workgroup claims together are neighbors.
+#define WAVEFRONT_PIXEL_BLOCK_SIZE 8
+
+layout(std430, binding = 1) buffer WavefrontQueues {
+	//How many rays are in each queue, and how many of them workgroups have claimed so far.
+	//The camera ray queue is every pixel, in blocks, so it's never stored, just counted. The shadow ray queue grows as camera rays hit.
+	uint queueLength[2];
+	uint queueClaimed[2];
+
+	//The size of the render targets, for turning queue entries and pixels into each other.
+	uint targetWidth;
+	uint targetHeight;
+};
+
+//Where each pixel's camera ray stopped, why, and how many steps it took.
+struct WavefrontHit {
+	vec3 endPoint;
+
+	//The steps in the low 16 bits, the stop mode above them
+	uint stepsAndStopMode;
+};
+
+layout(std430, binding = 2) buffer WavefrontHits {
+	WavefrontHit hits[];
+};
+
+//A queued shadow ray. It starts at origin and heads for a light.
+//The pixel's in the low WAVEFRONT_SHADOW_RAY_PIXEL_BITS of pixelAndLight, which is enough for 8192 x 8192,
+//and the light's above it: WAVEFRONT_SHADOW_RAY_SUN for the sun, or point light i as i + 1.
+#define WAVEFRONT_SHADOW_RAY_PIXEL_BITS 26
+#define WAVEFRONT_SHADOW_RAY_SUN 0u
+struct WavefrontShadowRay {
+	vec3 origin;
+	uint pixelAndLight;
+};
+
+layout(std430, binding = 3) buffer WavefrontShadowRays {
+	WavefrontShadowRay shadowRays[];
+};
+
+//1 if the sun reaches each pixel's hit point, 0 if it's in shadow. The sky counts as lit.
+layout(std430, binding = 4) buffer WavefrontSunVisibilities {
+	float sunVisibilities[];
+};
+
+//Each pixel's mask of the point lights whose shadow rays were blocked, bit i for light i, in the same form as Lights.glsl's masks.
+layout(std430, binding = 6) buffer WavefrontBlockedPointLights {
+	uint blockedPointLights[];
+};
@@ -0,0 +1,72 @@
+#version 460 core
+
+//Wavefront mode's last stage. Lights each pixel from where its camera ray stopped and which of its shadow rays got out,
+//and fills in the render targets exactly like FragmentMarcher.glsl does, so everything after the marcher works as normal.
+//It's a full screen pass rather than compute, so each target gets written in whatever format it's in. See WavefrontQueues.glsl.
+
+in vec3 rayView;
+flat in int viewIndex;
+
+#include "FrameParams.glsl"
+
+layout(binding = 3) uniform sampler2D skyLUT;
+#include "SkyLUTMapping.glsl"
+#include "Scene.glsl"
+#include "Shading.glsl"
+#include "Lights.glsl"
+#include "WavefrontQueues.glsl"
+
+layout(location = 0) out vec3 color;
+layout(location = 1) out float hitDistance;
+layout(location = 2) out float sunVisibility;
+layout(location = 3) out uint marchSteps;
+layout(location = 4) out vec2 hitNormal;
+layout(location = 5) out vec3 hitAmbient;
+
+void main() {
+	uint pixelIndex = uint(gl_FragCoord.y) * targetWidth + uint(gl_FragCoord.x);
+	WavefrontHit hit = hits[pixelIndex];
+	uint stopMode = hit.stepsAndStopMode >> 16;
+
+	mat4 matViewToWorld = matCameraToWorld * matViewToCamera[viewIndex];
+	vec3 rayWorld = normalize((matViewToWorld * vec4(rayView, 0)).xyz);
+	vec3 cameraPosition = (matViewToWorld * vec4(0, 0, 0, 1)).xyz;
+
+	hitDistance = length(hit.endPoint - cameraPosition);
+	marchSteps = hit.stepsAndStopMode & 0xFFFFu;
+	sunVisibility = sunVisibilities[pixelIndex];
+	hitNormal = vec2(0, 0);
+	hitAmbient = vec3(0, 0, 0);
+
+	if(stopMode == STOP_MODE_TOO_FAR) {
+		color = textureLod(skyLUT, skyLUTCoordinates(rayWorld), 0).rgb;
+		return;
+	}
+
+	//The camera ray only marched distances, so the surface it stopped at is looked up again for its color and normal
+	sdf(hit.endPoint, true);
+	hitNormal = octahedralEncode(surfaceNormal);
+	vec3 hitPoint = stopMode == STOP_MODE_CLOSE_ENOUGH ? hit.endPoint - surfaceNormal * sdfValue : hit.endPoint;
+
+	vec3 lightingComponent = vec3(0, 0, 0);
+	if(sunVisibility > 0) {
+		lightingComponent = sunLighting(hitPoint, cameraPosition, surfaceNormal, surfaceDiffuse, surfaceSpecular, surfaceShininess);
+	}
+
+	//The point lights' shadow rays were marched in the shadow stage, which marked the ones that were blocked
+	vec3 pointLightsOnPoint;
+	float viewDepth = -(matWorldToView * vec4(hitPoint, 1)).z;
+	choosePointLightShadowRays(ivec2(gl_FragCoord.xy), viewDepth, hitPoint, cameraPosition,
+		surfaceNormal, surfaceDiffuse, surfaceSpecular, surfaceShininess, pointLightsOnPoint);
+	lightingComponent += removeBlockedPointLights(pointLightsOnPoint, blockedPointLights[pixelIndex], hitPoint, cameraPosition,
+		surfaceNormal, surfaceDiffuse, surfaceSpecular, surfaceShininess);
+
+	vec3 ambientComponent = surfaceDiffuse * ambientLight;
+	float fog = fogFalloff(length(cameraPosition - hitPoint) / camRayTooFar);
+	color = mix(
+		ambientComponent + lightingComponent,
+		skyColor,
+		fog
+	);
+	hitAmbient = ambientComponent * (1 - fog);
+}
@@ -0,0 +1,56 @@
+#version 460 core
+
+//Wavefront mode's second stage. Marches the shadow rays the camera rays queued. Pixels whose sun shadow ray gets out are marked lit,
+//and point lights whose shadow ray doesn't get through are marked blocked. See WavefrontQueues.glsl.
+
+#include "FrameParams.glsl"
+#include "Scene.glsl"
+#include "Lights.glsl"
+#include "WavefrontQueues.glsl"
+#include "MarchStats.glsl"
+#include "WavefrontMarch.glsl"
+
+//Which light this lane's ray heads for, as packed in WavefrontShadowRay
+uint rayLight;
+
+bool fetchRay(uint index) {
+	uint pixelAndLight = shadowRays[index].pixelAndLight;
+	rayPixel = pixelAndLight & ((1u << WAVEFRONT_SHADOW_RAY_PIXEL_BITS) - 1u);
+	rayLight = pixelAndLight >> WAVEFRONT_SHADOW_RAY_PIXEL_BITS;
+	rayOrigin = shadowRays[index].origin;
+	rayPosition = rayOrigin;
+	rayCloseEnough = 0.0f;
+	raySteps = 0;
+	if(rayLight == WAVEFRONT_SHADOW_RAY_SUN) {
+		rayDirection = sunDirection;
+		rayTooFar = shadowRayTooFar;
+		rayMaxSteps = shadowRayMaxSteps;
+	}
+	else {
+		//A point light's shadow ray only has to get as far as the light, like pointLightReaches in Lights.glsl
+		vec3 toLight = pointLightPositions[rayLight - 1].xyz - rayOrigin;
+		rayTooFar = length(toLight);
+		rayDirection = toLight / rayTooFar;
+		rayMaxSteps = pointShadowRayMaxSteps;
+	}
+	return true;
+}
+
+//If the ray made it to 'infinity,' or all the way to its point light, the point is lit by that light. This is the only case in which it's lit.
+void retireRay() {
+	if(rayLight == WAVEFRONT_SHADOW_RAY_SUN) {
+		if(rayStopMode == STOP_MODE_TOO_FAR) {
+			sunVisibilities[rayPixel] = 1.0f;
+		}
+	}
+	else if(rayStopMode != STOP_MODE_TOO_FAR) {
+		atomicOr(blockedPointLights[rayPixel], 1u << (rayLight - 1));
+	}
+	if(collectMarchStats) {
+		atomicAdd(marchShadowRays, 1u);
+	}
+}
+
+void main() {
+	drainQueue(WAVEFRONT_QUEUE_SHADOW);
+}